@@ -0,0 +1,117 @@
+#include "arena/arena.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*
+ * Compares the bulk memory kernels against libc for large blocks.
+ *
+ * For each kernel, reports the bandwidth of the operation and the time to read a hot working set
+ * afterwards, relative to reading it with nothing in between. The slowdown approximates how much
+ * of the working set the operation evicted from the cache.
+ *
+ * Usage: bench_kernel [block MiB] [working set KiB] [rounds]
+ */
+
+static size_t          blockSize = 64 << 20;
+static size_t          hotSize   = 512 << 10;
+static size_t          rounds    = 10;
+static size_t          lineSize  = 64;
+static volatile size_t sink;
+
+static const char* isas[] = { "scalar", "sse2", "avx2", "avx512f" };
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void touch(const unsigned char* hot) {
+    size_t sum = 0;
+    for (size_t i = 0; i < hotSize; i += lineSize) {
+        sum += hot[i];
+    }
+    sink = sum;
+}
+
+template <class Op>
+static void run(const char* name, Op op, const unsigned char* hot, double baseline) {
+    double busy = 0;
+    double cold = 0;
+    for (size_t r = 0; r < rounds; r++) {
+        touch(hot);
+        double start = now();
+        op();
+        double mid = now();
+        touch(hot);
+        double end = now();
+        busy += mid - start;
+        cold += end - mid;
+    }
+
+    std::printf("%-22s %8.2f GB/s   working set reread %6.2fx\n",
+                name,
+                static_cast<double>(blockSize) * rounds / busy / 1e9,
+                cold / baseline);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        blockSize = std::strtoul(argv[1], nullptr, 10) << 20;
+    }
+    if (argc > 2) {
+        hotSize = std::strtoul(argv[2], nullptr, 10) << 10;
+    }
+    if (argc > 3) {
+        rounds = std::strtoul(argv[3], nullptr, 10);
+    }
+
+    Arena* arena = arena_init(2 * blockSize + hotSize, 0, 0);
+    if (!arena) {
+        std::fprintf(stderr, "Failed to create arena\n");
+        return 1;
+    }
+    unsigned char* src  = static_cast<unsigned char*>(arena_malloc(arena, blockSize));
+    unsigned char* dst  = static_cast<unsigned char*>(arena_malloc(arena, blockSize));
+    unsigned char* hot  = static_cast<unsigned char*>(arena_malloc(arena, hotSize));
+    std::memset(src, 1, blockSize);
+    std::memset(dst, 2, blockSize);
+    std::memset(hot, 3, hotSize);
+
+    double baseline = 0;
+    for (size_t r = 0; r < rounds; r++) {
+        touch(hot);
+        double start = now();
+        touch(hot);
+        baseline += now() - start;
+    }
+
+    std::printf("%zu MiB blocks, %zu KiB working set, %zu rounds, %s kernels selected\n\n",
+                blockSize >> 20,
+                hotSize >> 10,
+                rounds,
+                arena_kernel_isa());
+
+    arena_set_stream_threshold(SIZE_MAX);
+    run("memcpy", [&] { std::memcpy(dst, src, blockSize); }, hot, baseline);
+    run("memset", [&] { std::memset(dst, 0, blockSize); }, hot, baseline);
+
+    arena_set_stream_threshold(0);
+    for (const char* isa : isas) {
+        if (arena_set_kernel_isa(isa) != ARENA_SUCCESS) {
+            continue;
+        }
+
+        std::vector<char> name(64);
+        std::snprintf(name.data(), name.size(), "arena_memcpy %s", isa);
+        run(name.data(), [&] { arena_memcpy(dst, src, blockSize); }, hot, baseline);
+        std::snprintf(name.data(), name.size(), "arena_memset %s", isa);
+        run(name.data(), [&] { arena_memset(dst, 0, blockSize); }, hot, baseline);
+    }
+
+    arena_destroy(arena);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "arena/arena.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Compares STL containers on arena-backed memory resources against the default resource.
+ *
+ * Usage: bench_pmr [elements] [rounds]
+ */
+
+static size_t elements = 10000;
+static size_t rounds   = 20;
+
+static void bench_vector(std::pmr::memory_resource* resource) {
+    std::pmr::vector<int> v(resource);
+    for (size_t i = 0; i < elements; i++) {
+        v.push_back(static_cast<int>(i));
+    }
+}
+
+static void bench_map(std::pmr::memory_resource* resource) {
+    std::pmr::unordered_map<size_t, size_t> m(resource);
+    for (size_t i = 0; i < elements; i++) {
+        m[i * 2654435761u] = i;
+    }
+}
+
+static void bench_strings(std::pmr::memory_resource* resource) {
+    std::pmr::vector<std::pmr::string> v(resource);
+    for (size_t i = 0; i < elements; i++) {
+        v.emplace_back(64, static_cast<char>('a' + i % 26));
+    }
+}
+
+template <class Reset>
+static double run(void (*bench)(std::pmr::memory_resource*),
+                  std::pmr::memory_resource* resource,
+                  Reset                      reset) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        bench(resource);
+        reset();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        elements = std::strtoul(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        rounds = std::strtoul(argv[2], nullptr, 10);
+    }
+
+    size_t arenaSize = elements * 256 + (1 << 20);
+    Arena* unmanaged = arena_init(arenaSize, 0, 0);
+    Arena* managed   = arena_init_flags(arenaSize, elements * 4 + 64, ARENA_FLAG_MANAGED);
+    if (!unmanaged || !managed) {
+        std::fprintf(stderr, "Failed to initialize arenas\n");
+        return 1;
+    }
+
+    ArenaResource                       unmanagedResource(unmanaged);
+    ArenaResource                       managedResource(managed);
+    std::pmr::monotonic_buffer_resource monotonic;
+
+    struct {
+        const char* name;
+        void (*bench)(std::pmr::memory_resource*);
+    } benches[] = {
+        { "vector<int>", bench_vector },
+        { "unordered_map", bench_map },
+        { "vector<string>", bench_strings },
+    };
+
+    std::printf("%zu elements, %zu rounds, microseconds per round\n", elements, rounds);
+    std::printf("%-16s %12s %12s %12s %12s\n", "", "default", "monotonic", "unmanaged", "managed");
+    for (const auto& b : benches) {
+        double def = run(b.bench, std::pmr::new_delete_resource(), [] {});
+        double mon = run(b.bench, &monotonic, [&] { monotonic.release(); });
+        double unm = run(b.bench, &unmanagedResource, [&] { arena_reset(unmanaged); });
+        double man = run(b.bench, &managedResource, [&] { arena_reset(managed); });
+        std::printf("%-16s %12.1f %12.1f %12.1f %12.1f\n", b.name, def, mon, unm, man);
+    }
+
+    arena_destroy(unmanaged);
+    arena_destroy(managed);
+    return 0;
+}
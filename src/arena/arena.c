@@ -1,9 +1,72 @@
 #include "arena.h"
 
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-static ArenaBlock* arena_find_empty_block(Arena* arena);
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+/**
+ * @brief Internal flag set when a copy-on-write arena is a private view of its snapshot.
+ */
+#define ARENA_FLAG_SNAPSHOT 0x0100
+
+/**
+ * @brief Internal flag set on arenas whose memory is a private mapping of a file.
+ */
+#define ARENA_FLAG_MAPPED 0x0400
+
+/**
+ * @brief Number of pagemap entries read at once when looking for modified pages.
+ */
+#define ARENA_PAGEMAP_BATCH 512
+
+/**
+ * @brief Runs of at most this many pointers are insertion sorted instead of radix sorted.
+ */
+#define ARENA_SORT_MIN 32
+
+/**
+ * @struct ArenaBacking
+ * @brief Shared memory file backing copy-on-write arenas
+ */
+struct arena_backing_s {
+    int    fd; //!< The memfd holding the arena contents, or the frozen snapshot.
+    size_t refs; //!< The number of arenas mapping the file.
+};
+
+static ArenaBlock*   arena_find_empty_block(Arena* arena);
+static void          arena_release_block(ArenaBlock* block);
+static ArenaBlock*   arena_coalesce_block(ArenaBlock* block);
+static void          arena_trim_block(Arena* arena, ArenaBlock* block);
+static void          arena_sort_ptrs(void** ptrs, size_t n, uintptr_t base, unsigned shift);
+static bool  arena_sweep_free(Arena* arena, ArenaBlock** current, ArenaBlock** pending, size_t idx);
+static void* arena_remote_next(void* p);
+static void  arena_remote_link(void* p, void* next);
+static void* arena_merge_remote(void* a, void* b);
+static void* arena_sort_remote(void* list);
+static bool          arena_split_block(Arena* arena, ArenaBlock* block, size_t size);
+static bool          arena_grow_block(Arena* arena, ArenaBlock* block, size_t size);
+static ArenaBlock*   arena_take_block(Arena* arena, size_t size, size_t alignment);
+static void*         arena_take(Arena* arena, size_t size, size_t alignment);
+static size_t        arena_page_size(void);
+static size_t        arena_release_pages(Arena* arena, size_t start, size_t end);
+static void          arena_prepare_range(Arena* arena, void* p, size_t size, bool zero);
+static void          arena_clone_meta(Arena* clone, const Arena* arena);
+static ArenaBacking* arena_new_backing(size_t size);
+static void*         arena_map_backing(Arena* arena);
+static void          arena_free_mem(Arena* arena);
+static int           arena_freeze_backing(Arena* arena);
+static int           arena_remap_backing(Arena* arena, ArenaBacking* backing);
+static int           arena_write_back(Arena* arena, int fd, bool all);
+static ArenaRef      arena_ref_or_undo(Arena* arena, void* p);
 
 /**
  * @brief Initializes an Arena with a given size.
@@ -14,25 +77,49 @@ static ArenaBlock* arena_find_empty_block(Arena* arena);
  * @return A pointer to the initialized Arena structure, or NULL on failure.
  */
 Arena* arena_init(size_t size, size_t maxBlocks, int managed) {
+    return arena_init_flags(size, maxBlocks, managed ? ARENA_FLAG_MANAGED : 0);
+}
+
+/**
+ * @brief Initializes an Arena with a given size and ARENA_FLAG_* flags.
+ *
+ * @param size The total size of the arena to allocate.
+ * @param maxBlocks The maximum number of blocks that can be allocated at once.
+ * @param flags ARENA_FLAG_MANAGED to manage blocks, allowing for freeing and dynamic reallocation,
+ * optionally combined with ARENA_FLAG_COW to allow cheap copy-on-write cloning.
+ * @return A pointer to the initialized Arena structure, or NULL on failure.
+ */
+Arena* arena_init_flags(size_t size, size_t maxBlocks, int flags) {
     Arena* arena;
 
     if (!(arena = (Arena*) malloc(sizeof(Arena)))) {
         return NULL;
     }
 
-    arena->idx       = 0;
-    arena->size      = size;
-    arena->maxBlocks = maxBlocks;
-    arena->managed   = managed;
+    arena->idx           = 0;
+    arena->size          = size;
+    arena->maxBlocks     = maxBlocks;
+    arena->managed       = flags & ARENA_FLAG_MANAGED;
+    arena->flags         = flags & ~ARENA_FLAG_INTERNAL;
+    arena->backing       = NULL;
+    arena->remoteFree    = NULL;
+    arena->trimThreshold = 0;
+    arena->zeroPages     = NULL;
 
-    if (!(arena->mem = malloc(size))) {
+    if (flags & ARENA_FLAG_COW) {
+        arena->mem = arena_map_backing(arena);
+    } else {
+        arena->mem = malloc(size);
+    }
+
+    if (!arena->mem) {
         free(arena);
         return NULL;
     }
 
-    if (managed) {
+    if (arena->managed) {
         if (!(arena->head = (ArenaBlock*) malloc(sizeof(ArenaBlock) * maxBlocks))) {
-            free(arena->mem);
+            arena_free_mem(arena);
             free(arena);
             return NULL;
         }
@@ -41,42 +128,217 @@ Arena* arena_init(size_t size, size_t maxBlocks, int managed) {
         arena->head[0].tag    = ARENA_TAG_NONE;
         arena->head[0].status = ARENA_STATUS_FREE;
         arena->head[0].prev   = NULL;
-        for (size_t i = 1; i < maxBlocks; i++) {
-            arena->head[i].idx      = -1;
-            arena->head[i].size     = 0;
-            arena->head[i].tag      = ARENA_TAG_NONE;
-            arena->head[i].prev     = &arena->head[i - 1];
-            arena->head[i - 1].next = &arena->head[i];
-            arena->head[i].status   = ARENA_STATUS_UNDEFINED;
-        }
-        arena->head[maxBlocks - 1].next = NULL;
+        arena->head[0].next   = NULL;
+        arena->blockCount     = 1;
     } else {
-        arena->head = NULL;
-        arena->ptr  = arena->mem;
+        arena->head       = NULL;
+        arena->ptr        = arena->mem;
+        arena->blockCount = 0;
+    }
+
+    return arena;
+}
+
+/**
+ * @brief Initializes an Arena entirely inside caller-provided memory, without allocating.
+ *
+ * The Arena structure is placed at the start of the buffer, followed by the block descriptors if
+ * descriptors is NULL in managed mode, and the rest of the buffer is the arena's memory. The buffer
+ * may itself be allocated from another arena. arena_destroy() does not free any of it.
+ *
+ * @param buffer Memory to place the arena in. It must outlive the arena.
+ * @param size Size of the buffer in bytes.
+ * @param descriptors Array of maxBlocks block descriptors, or NULL to take them from the buffer.
+ * Ignored in unmanaged mode.
+ * @param maxBlocks The maximum number of blocks that can be allocated at once.
+ * @param flags ARENA_FLAG_MANAGED to manage blocks. ARENA_FLAG_COW is not supported.
+ * @return A pointer to the initialized Arena structure, or NULL if the buffer is too small.
+ */
+Arena* arena_init_in(
+    void* buffer, size_t size, ArenaBlock* descriptors, size_t maxBlocks, int flags) {
+    size_t start  = (size_t) buffer;
+    size_t end    = start + size;
+    size_t offset = (start + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+    Arena* arena  = (Arena*) offset;
+
+    if ((flags & ARENA_FLAG_COW) || ((flags & ARENA_FLAG_MANAGED) && maxBlocks == 0)) {
+        return NULL;
     }
 
+    offset += sizeof(Arena);
+    if ((flags & ARENA_FLAG_MANAGED) && !descriptors) {
+        offset      = (offset + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+        descriptors = (ArenaBlock*) offset;
+        offset += sizeof(ArenaBlock) * maxBlocks;
+    }
+    offset = (offset + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+    if (end < start || offset >= end) {
+        return NULL;
+    }
+
+    arena->mem           = (void*) offset;
+    arena->idx           = 0;
+    arena->size          = end - offset;
+    arena->maxBlocks     = maxBlocks;
+    arena->managed       = flags & ARENA_FLAG_MANAGED;
+    arena->flags         = (flags & ~ARENA_FLAG_INTERNAL) | ARENA_FLAG_EXTERNAL;
+    arena->backing       = NULL;
+    arena->remoteFree    = NULL;
+    arena->trimThreshold = 0;
+    arena->zeroPages     = NULL;
+    arena->head          = arena->managed ? descriptors : NULL;
+    arena->ptr           = arena->mem;
+    arena->blockCount    = 0;
+    arena_reset(arena);
+
     return arena;
 }
 
 /**
  * @brief Destroys the given Arena, freeing all associated memory.
  *
+ * Arenas created by arena_init_in() or the static arena macros own no memory, so nothing is freed.
+ *
  * @param arena Pointer to the Arena structure to destroy.
  * @return ARENA_SUCCESS on success.
  */
 int arena_destroy(Arena* arena) {
+    if (arena->flags & ARENA_FLAG_EXTERNAL) {
+        return ARENA_SUCCESS;
+    }
+
     if (arena->mem) {
-        free(arena->mem);
+        arena_free_mem(arena);
     }
 
     if (arena->managed) {
         free(arena->head);
     }
 
+    free(arena->zeroPages);
     free(arena);
     return ARENA_SUCCESS;
 }
 
+/**
+ * @brief Creates an independent copy of the arena, including its block metadata.
+ *
+ * For arenas created with ARENA_FLAG_COW, the memory is not copied. Both arenas become private
+ * views of a frozen snapshot, and a page is only copied when either arena first writes to it.
+ * Cloning an arena that is already such a view writes its modified pages back into the snapshot
+ * if no other arena uses it, or copies the arena into a new snapshot otherwise. Arenas created
+ * without ARENA_FLAG_COW are copied in full.
+ *
+ * Arenas sharing a snapshot must not be cloned or destroyed concurrently. Blocks queued by
+ * arena_free_remote() are collected first, so this must be called by the owning thread.
+ *
+ * @param arena Pointer to the Arena structure to clone.
+ * @return A pointer to the new Arena structure, or NULL on failure.
+ */
+Arena* arena_clone(Arena* arena) {
+    Arena* clone;
+
+    arena_collect_remote(arena);
+
+    if (!(arena->flags & ARENA_FLAG_COW)) {
+        if (!(clone = arena_init_flags(arena->size, arena->maxBlocks, arena->flags))) {
+            return NULL;
+        }
+        arena_memcpy(clone->mem, arena->mem, arena->size);
+        arena_clone_meta(clone, arena);
+        return clone;
+    }
+
+    if (arena_freeze_backing(arena) != ARENA_SUCCESS) {
+        return NULL;
+    }
+
+    if (!(clone = (Arena*) malloc(sizeof(Arena)))) {
+        return NULL;
+    }
+
+    *clone           = *arena;
+    clone->head      = NULL;
+    clone->zeroPages = NULL;
+    clone->mem
+        = mmap(NULL, arena->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, arena->backing->fd, 0);
+    if (clone->mem == MAP_FAILED) {
+        free(clone);
+        return NULL;
+    }
+    clone->backing->refs++;
+
+    if (clone->managed) {
+        if (!(clone->head = (ArenaBlock*) malloc(sizeof(ArenaBlock) * clone->maxBlocks))) {
+            arena_destroy(clone);
+            return NULL;
+        }
+    }
+
+    arena_clone_meta(clone, arena);
+    return clone;
+}
+
+/**
+ * @brief Frees every allocation in the arena at once.
+ *
+ * This takes constant time in both modes. In managed mode, the descriptors past the first one are
+ * not touched; they are treated as undefined until they are handed out again.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @return ARENA_SUCCESS on success.
+ */
+int arena_reset(Arena* arena) {
+    if (!arena->managed) {
+        arena->ptr = arena->mem;
+        return ARENA_SUCCESS;
+    }
+
+    // Pending remote frees are of blocks that no longer exist
+    __atomic_store_n(&arena->remoteFree, NULL, __ATOMIC_RELAXED);
+
+    arena->head[0].idx    = 0;
+    arena->head[0].size   = arena->size;
+    arena->head[0].tag    = ARENA_TAG_NONE;
+    arena->head[0].status = ARENA_STATUS_FREE;
+    arena->head[0].prev   = NULL;
+    arena->head[0].next   = NULL;
+    arena->blockCount     = 1;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Frees every allocation in the arena at once, and adjusts its resident pages.
+ *
+ * ARENA_RESET_WARM writes to each page of the first threshold bytes so that the next use of the
+ * arena takes no page faults. ARENA_RESET_RELEASE returns the whole pages past the first threshold
+ * bytes to the OS, which is best-effort and takes time proportional to the released range.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param mode How to handle the arena's pages.
+ * @param threshold Number of bytes at the start of the arena to keep warm.
+ * @return ARENA_SUCCESS on success.
+ */
+int arena_reset_mode(Arena* arena, ArenaResetMode mode, size_t threshold) {
+    arena_reset(arena);
+
+    if (threshold > arena->size) {
+        threshold = arena->size;
+    }
+
+    if (mode == ARENA_RESET_WARM) {
+        size_t pageSize = arena_page_size();
+        for (size_t i = 0; i < threshold; i += pageSize) {
+            ((volatile char*) arena->mem)[i] = 0;
+        }
+    } else if (mode == ARENA_RESET_RELEASE) {
+        arena_release_pages(arena, threshold, arena->size);
+    }
+
+    return ARENA_SUCCESS;
+}
+
 /**
  * @brief Dumps the raw memory of the arena to the given file stream.
  *
@@ -85,6 +347,59 @@ int arena_destroy(Arena* arena) {
  */
 void arena_dump(Arena* arena, FILE* f) { fwrite(arena->mem, 1, arena->size, f); }
 
+/**
+ * @brief Maps a file written by arena_dump() as an unmanaged arena.
+ *
+ * The file is mapped privately, so writes to the arena are not written back. The whole contents
+ * count as allocated, and ArenaRef references stored in them resolve against the new arena as
+ * they did against the dumped one. Block metadata is not part of a dump, so the arena is unmanaged
+ * even if the dumped one was managed.
+ *
+ * @param path Path of the file to map.
+ * @return A pointer to the new Arena structure, or NULL on failure.
+ */
+Arena* arena_open(const char* path) {
+    struct stat st;
+    Arena*      arena;
+    void*       mem;
+    int         fd;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uintmax_t) st.st_size > SIZE_MAX) {
+        close(fd);
+        return NULL;
+    }
+
+    mem = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (!(arena = (Arena*) malloc(sizeof(Arena)))) {
+        munmap(mem, (size_t) st.st_size);
+        return NULL;
+    }
+
+    arena->mem           = mem;
+    arena->ptr           = (char*) mem + st.st_size;
+    arena->head          = NULL;
+    arena->idx           = 0;
+    arena->size          = (size_t) st.st_size;
+    arena->maxBlocks     = 0;
+    arena->blockCount    = 0;
+    arena->managed       = false;
+    arena->flags         = ARENA_FLAG_MAPPED;
+    arena->backing       = NULL;
+    arena->remoteFree    = NULL;
+    arena->trimThreshold = 0;
+    arena->zeroPages     = NULL;
+    return arena;
+}
+
 /**
  * @brief Prints a human-readable representation of the arena's blocks to stdout.
  *
@@ -138,29 +453,8 @@ ArenaBlock* arena_free_block(Arena* arena, ArenaBlock* block) {
         return NULL;
     }
 
-    ArenaBlock* tmp = NULL;
-    block->status   = ARENA_STATUS_FREE;
-    block->tag      = ARENA_TAG_NONE;
-
-    if (block->next != NULL && block->next->status == ARENA_STATUS_FREE) {
-        block->size += block->next->size;
-        tmp               = block->next;
-        block->next       = block->next->next;
-        block->next->prev = block;
-    }
-
-    if (block->prev != NULL && block->prev->status == ARENA_STATUS_FREE) {
-        block->idx = block->prev->idx;
-        block->size += block->prev->size;
-
-        tmp               = block->prev;
-        block->prev       = block->prev->prev;
-        block->prev->next = block;
-    }
-
-    if (tmp) {
-        tmp->status = ARENA_STATUS_UNDEFINED;
-    }
+    block = arena_coalesce_block(block);
+    arena_trim_block(arena, block);
     return block->next;
 }
 
@@ -203,31 +497,11 @@ ArenaBlock* arena_alloc(Arena* arena, size_t size) {
         return NULL;
     }
 
-    ArenaBlock* current = arena->head;
-    while (current) {
-        if (current->status == ARENA_STATUS_FREE && current->size >= size) {
-            if (current->size > size) {
-                // Create another block in between
-                ArenaBlock* oldNext = current->next;
-                ArenaBlock* newNext;
-
-                newNext         = arena_find_empty_block(arena);
-                newNext->next   = oldNext;
-                newNext->idx    = current->idx + size;
-                newNext->size   = current->size - size;
-                newNext->status = ARENA_STATUS_FREE;
-                newNext->tag    = ARENA_TAG_NONE;
-
-                current->next   = newNext;
-                current->size   = size;
-            }
-            current->status = ARENA_STATUS_USED;
-            return current;
-        }
-        current = current->next;
+    ArenaBlock* block = arena_take_block(arena, size, 1);
+    if (block) {
+        arena_prepare_range(arena, ARENA_PTR(arena, block), size, false);
     }
-
-    return NULL;
+    return block;
 }
 
 /**
@@ -238,38 +512,55 @@ ArenaBlock* arena_alloc(Arena* arena, size_t size) {
  * @return Pointer to the allocated memory, or NULL if allocation fails.
  */
 void* arena_malloc(Arena* arena, size_t size) {
-    if (!arena->managed) {
-        void*  oldHead = arena->ptr;
-        size_t oldSize = (size_t) (arena->ptr) - (size_t) (arena->mem);
-        if (size + oldSize > arena->size) {
-            return NULL;
-        }
-        arena->ptr = (char*) arena->ptr + size;
-        return oldHead;
+    void* result = arena_take(arena, size, 1);
+    if (result) {
+        arena_prepare_range(arena, result, size, false);
     }
+    return result;
+}
 
-    ArenaBlock* block = arena_alloc(arena, size);
-    if (!block) {
+/**
+ * @brief Allocates a block of memory whose address is a multiple of the given alignment.
+ *
+ * In managed mode, the padding needed to align the block stays available as a free block.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param alignment Required alignment, a power of two.
+ * @param size Size of the memory block to allocate.
+ * @return Pointer to the allocated memory, or NULL if allocation fails or the alignment is invalid.
+ */
+void* arena_memalign(Arena* arena, size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
         return NULL;
     }
 
-    return ARENA_PTR(arena, block);
+    void* result = arena_take(arena, size, alignment);
+    if (result) {
+        arena_prepare_range(arena, result, size, false);
+    }
+    return result;
 }
 
 /**
  * @brief Allocates memory for an array of elements, initializing all bytes to zero.
  *
+ * Pages that are known to still be zero since they were returned to the OS are not cleared again.
+ *
  * @param arena Pointer to the Arena structure.
  * @param num Number of elements to allocate.
  * @param size Size of each element.
  * @return Pointer to the allocated memory, or NULL on failure.
  */
 void* arena_calloc(Arena* arena, size_t num, size_t size) {
-    void* result = arena_malloc(arena, num * size);
+    if (size != 0 && num > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void* result = arena_take(arena, num * size, 1);
     if (result == NULL) {
         return NULL;
     }
-    memset(result, 0, num * size);
+    arena_prepare_range(arena, result, num * size, true);
     return result;
 }
 
@@ -285,7 +576,9 @@ void* arena_realloc(Arena* arena, void* p, size_t size) {
     if (!arena->managed) {
         void* newP = arena_malloc(arena, size);
         if (newP != NULL) {
-            memcpy(newP, p, size);
+            // The old block ends at or before the old top of the arena, which is newP
+            size_t avail = (size_t) ((char*) newP - (char*) p);
+            arena_memcpy(newP, p, size < avail ? size : avail);
         }
         return newP;
     }
@@ -301,40 +594,77 @@ void* arena_realloc(Arena* arena, void* p, size_t size) {
         return p;
     } else if (size < block->size) {
         // New size less than old size
-        int oldSize      = block->size;
-        int delta        = oldSize - size;
-        block->size      = size;
-        ArenaBlock* next = block->next;
-        if (next) {
-            if (next->status == ARENA_STATUS_FREE) {
-                // Expand next block
-                next->idx -= delta;
-                next->size += delta;
-            } else {
-                // Create new free block in between
-                ArenaBlock* oldNext = next;
-                if (!(next = (ArenaBlock*) malloc(sizeof(ArenaBlock)))) {
-                    return NULL;
-                }
-
-                block->next  = next;
-                next->size   = delta;
-                next->idx    = block->idx + size;
-                next->status = ARENA_STATUS_FREE;
-                next->next   = oldNext;
-                next->prev   = block;
-            }
+        size_t      delta = block->size - size;
+        ArenaBlock* next  = block->next;
+        if (next && next->status == ARENA_STATUS_FREE) {
+            // Expand next block
+            block->size = size;
+            next->idx -= delta;
+            next->size += delta;
+        } else {
+            // Create new free block in between, or keep the tail if out of descriptors
+            arena_split_block(arena, block, size);
         }
 
+        return p;
+    } else if (arena_grow_block(arena, block, size)) {
+        // Grown in place
         return p;
     } else {
         // New size greater than old size
-        ArenaBlock* newBlock = arena_malloc(arena, size);
+        ArenaBlock* newBlock = arena_alloc(arena, size);
+        if (!newBlock) {
+            return NULL;
+        }
         ARENA_COPY(arena, newBlock, block);
         arena_free_block(arena, block);
         return ARENA_PTR(arena, newBlock);
     }
-    return NULL;
+}
+
+/**
+ * @brief Resizes an allocation whose previous size is known by the caller.
+ *
+ * Unlike arena_realloc(), this also grows and shrinks in place in unmanaged mode when p is the
+ * most recent allocation, since the top of the arena is then the end of p. Otherwise, the data
+ * is moved to a new allocation and only oldSize bytes are copied.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param p Pointer to the existing memory block, or NULL to allocate a new one.
+ * @param oldSize Current size of the memory block.
+ * @param size New size for the memory block.
+ * @return Pointer to the resized memory, or NULL on failure.
+ */
+void* arena_resize(Arena* arena, void* p, size_t oldSize, size_t size) {
+    if (p == NULL) {
+        return arena_malloc(arena, size);
+    }
+
+    if (arena->managed) {
+        return arena_realloc(arena, p, size);
+    }
+
+    if ((char*) p + oldSize == (char*) arena->ptr) {
+        // Most recent allocation, move the top of the arena
+        if (size > arena->size - (size_t) ((char*) p - (char*) arena->mem)) {
+            return NULL;
+        }
+        if (size > oldSize) {
+            arena_prepare_range(arena, arena->ptr, size - oldSize, false);
+        }
+        arena->ptr = (char*) p + size;
+        return p;
+    }
+
+    if (size <= oldSize) {
+        return p;
+    }
+
+    void* newP = arena_malloc(arena, size);
+    if (newP != NULL) {
+        arena_memcpy(newP, p, oldSize);
+    }
+    return newP;
 }
 
 /**
@@ -363,86 +693,328 @@ int arena_free(Arena* arena, void* p) {
 }
 
 /**
- * @brief Retrieves the tag associated with a memory block.
- *
- * This function can only be used if the arena is in managed mode.
+ * @brief Converts a pointer into the arena to a reference.
  *
  * @param arena Pointer to the Arena structure.
- * @param p Pointer to the memory block.
- * @return The tag of the block, or ARENA_FAILURE if the block is not found.
+ * @param p Pointer into the arena's memory, or NULL.
+ * @return Reference to p, or ARENA_REF_NULL if p is NULL, outside the arena, or too far into it.
  */
-int arena_get_tag(Arena* arena, void* p) {
-    if (!arena->managed) {
-        return ARENA_FAILURE;
-    }
+ArenaRef arena_ref(Arena* arena, const void* p) {
+    size_t idx = (size_t) p - (size_t) arena->mem;
 
-    ArenaBlock* block = arena_get_block(arena, p);
-    if (block) {
-        return block->tag;
+    if (p == NULL || (size_t) p < (size_t) arena->mem || idx > arena->size
+        || idx > ARENA_REF_MAX_OFFSET) {
+        return ARENA_REF_NULL;
     }
-    return ARENA_FAILURE;
+    return (ArenaRef) (idx + 1);
 }
 
 /**
- * @brief Sets the tag for a memory block.
- *
- * This function can only be used if the arena is in managed mode.
+ * @brief Converts a reference to a pointer into the arena.
  *
  * @param arena Pointer to the Arena structure.
- * @param p Pointer to the memory block.
- * @param tag The tag value to set.
- * @return ARENA_SUCCESS on success, ARENA_FAILURE if the block is not found.
+ * @param ref Reference to convert.
+ * @return Pointer into the arena's memory, or NULL if ref is ARENA_REF_NULL or outside the arena.
  */
-int arena_set_tag(Arena* arena, void* p, int tag) {
-    if (!arena->managed) {
-        return ARENA_FAILURE;
+void* arena_deref(Arena* arena, ArenaRef ref) {
+    if (ref == ARENA_REF_NULL || (size_t) ref - 1 > arena->size) {
+        return NULL;
     }
+    return ARENA_REF_PTR(arena, ref);
+}
 
-    ArenaBlock* block = arena_get_block(arena, p);
-    if (block) {
-        block->tag = tag;
-        return ARENA_SUCCESS;
-    }
+/**
+ * @brief Allocates a block of memory and returns a reference to it.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param size Size of the memory block to allocate.
+ * @return Reference to the allocated memory, or ARENA_REF_NULL if allocation fails.
+ */
+ArenaRef arena_malloc_ref(Arena* arena, size_t size) {
+    return arena_ref_or_undo(arena, arena_malloc(arena, size));
+}
 
-    return ARENA_FAILURE;
+/**
+ * @brief Allocates zeroed memory for an array of elements and returns a reference to it.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param num Number of elements to allocate.
+ * @param size Size of each element.
+ * @return Reference to the allocated memory, or ARENA_REF_NULL on failure.
+ */
+ArenaRef arena_calloc_ref(Arena* arena, size_t num, size_t size) {
+    return arena_ref_or_undo(arena, arena_calloc(arena, num, size));
 }
 
 /**
- * @brief Frees all memory blocks with the specified tag.
+ * @brief Reallocates a referenced block of memory to a new size.
  *
- * This function can only be used if the arena is in managed mode.
+ * In arenas larger than ARENA_REF_MAX_OFFSET, a block that moves out of reach of a reference is
+ * freed, and ARENA_REF_NULL is returned.
  *
  * @param arena Pointer to the Arena structure.
- * @param tag The tag value to collect.
+ * @param ref Reference to the existing memory block, or ARENA_REF_NULL to allocate a new one.
+ * @param size New size for the memory block.
+ * @return Reference to the reallocated memory, or ARENA_REF_NULL on failure.
  */
-void arena_collect_tag(Arena* arena, int tag) {
-    if (!arena->managed) {
-        return;
-    }
+ArenaRef arena_realloc_ref(Arena* arena, ArenaRef ref, size_t size) {
+    void* p = arena_deref(arena, ref);
 
-    ArenaBlock* block;
-    while ((block = arena_get_block_by_tag(arena, tag, 0))) {
-        arena_free_block(arena, block);
+    if (p == NULL) {
+        return ref == ARENA_REF_NULL ? arena_malloc_ref(arena, size) : ARENA_REF_NULL;
     }
+    return arena_ref_or_undo(arena, arena_realloc(arena, p, size));
 }
 
 /**
- * @brief Retrieves the n-th block with the specified tag.
+ * @brief Frees a referenced block of memory within the arena.
  *
  * This function can only be used if the arena is in managed mode.
  *
  * @param arena Pointer to the Arena structure.
- * @param tag The tag value to search for.
- * @param n The index of the block to retrieve.
- * @return Pointer to the n-th ArenaBlock with the specified tag, or NULL if not found.
+ * @param ref Reference to the memory block to free.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE on failure.
  */
-ArenaBlock* arena_get_block_by_tag(Arena* arena, int tag, int n) {
-    if (!arena->managed) {
-        return NULL;
+int arena_free_ref(Arena* arena, ArenaRef ref) {
+    void* p = arena_deref(arena, ref);
+
+    if (p == NULL) {
+        return ARENA_FAILURE;
+    }
+    return arena_free(arena, p);
+}
+
+/**
+ * @brief Frees many blocks of memory within the arena in one pass over its blocks.
+ *
+ * The pointers are radix sorted by address in place, so every block is found and coalesced in a
+ * single walk of the block list instead of one walk per pointer, and nothing is allocated. NULL
+ * pointers, pointers not at the start of a used block, and repeated pointers are not freed.
+ *
+ * This function can only be used if the arena is in managed mode.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param ptrs Array of pointers to the memory blocks to free. Reordered on return: pointers into
+ * the arena come first, sorted by address, followed by the rest.
+ * @param n Number of pointers.
+ * @param status Array of n results, or NULL. On return, status[i] is ARENA_SUCCESS if the reordered
+ * ptrs[i] was freed and ARENA_FAILURE otherwise.
+ * @return ARENA_SUCCESS if every pointer was freed, ARENA_FAILURE otherwise.
+ */
+int arena_free_batch(Arena* arena, void** ptrs, size_t n, int* status) {
+    ArenaBlock* current = arena->head;
+    ArenaBlock* pending = NULL;
+    size_t      valid   = 0;
+    unsigned    shift   = 0;
+    int         result  = ARENA_SUCCESS;
+
+    if (status) {
+        for (size_t i = 0; i < n; i++) {
+            status[i] = ARENA_FAILURE;
+        }
+    }
+
+    if (!arena->managed) {
+        return n ? ARENA_FAILURE : ARENA_SUCCESS;
+    }
+
+    // Move the pointers into the arena to the front, so only their offsets need sorting
+    for (size_t i = 0; i < n; i++) {
+        size_t idx = (size_t) ptrs[i] - (size_t) arena->mem;
+        if (ptrs[i] != NULL && (size_t) ptrs[i] >= (size_t) arena->mem && idx < arena->size) {
+            void* p       = ptrs[i];
+            ptrs[i]       = ptrs[valid];
+            ptrs[valid++] = p;
+        }
+    }
+
+    while (shift + 8 < sizeof(size_t) * 8 && ((arena->size - 1) >> (shift + 8)) != 0) {
+        shift += 8;
+    }
+    arena_sort_ptrs(ptrs, valid, (uintptr_t) arena->mem, shift);
+
+    for (size_t i = 0; i < valid; i++) {
+        size_t idx = (size_t) ptrs[i] - (size_t) arena->mem;
+        if (!arena_sweep_free(arena, &current, &pending, idx)) {
+            result = ARENA_FAILURE;
+        } else if (status) {
+            status[i] = ARENA_SUCCESS;
+        }
+    }
+    if (valid < n) {
+        result = ARENA_FAILURE;
+    }
+
+    if (pending) {
+        arena_trim_block(arena, pending);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Returns the whole pages inside free memory to the OS.
+ *
+ * In managed mode, this covers every free block. In unmanaged mode, it covers the space past the
+ * current position. The released pages are remembered as zero so arena_calloc() can skip them.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @return Number of bytes newly returned to the OS.
+ */
+size_t arena_trim(Arena* arena) {
+    if (!arena->managed) {
+        return arena_release_pages(
+            arena, (size_t) ((char*) arena->ptr - (char*) arena->mem), arena->size);
+    }
+
+    size_t      released = 0;
+    ArenaBlock* current  = arena->head;
+    while (current) {
+        if (current->status == ARENA_STATUS_FREE) {
+            released += arena_release_pages(arena, current->idx, current->idx + current->size);
+        }
+        current = current->next;
+    }
+    return released;
+}
+
+/**
+ * @brief Frees a block of memory within the arena from a thread that does not own the arena.
+ *
+ * The pointer is pushed onto a lock-free queue and is freed by the owning thread during its next
+ * allocation, or when it calls arena_collect_remote(). The first sizeof(void*) bytes of the block
+ * are used as the queue link, so the block must be at least that large. Any number of threads may
+ * call this concurrently with each other and with the owner.
+ *
+ * This function can only be used if the arena is in managed mode.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param p Pointer to the memory block to free.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is not managed.
+ */
+int arena_free_remote(Arena* arena, void* p) {
+    if (!arena->managed || p == NULL) {
+        return ARENA_FAILURE;
+    }
+
+    void* head = __atomic_load_n(&arena->remoteFree, __ATOMIC_RELAXED);
+    do {
+        memcpy(p, &head, sizeof(head));
+    } while (!__atomic_compare_exchange_n(
+        &arena->remoteFree, &head, p, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Frees every block queued by arena_free_remote().
+ *
+ * This must only be called by the thread that owns the arena. arena_alloc() and arena_malloc()
+ * call it automatically when the queue is not empty. The queue is sorted in place by address and
+ * freed in one pass over the blocks, without allocating.
+ *
+ * @param arena Pointer to the Arena structure.
+ */
+void arena_collect_remote(Arena* arena) {
+    if (!arena->managed) {
+        return;
+    }
+
+    void*       p       = __atomic_exchange_n(&arena->remoteFree, NULL, __ATOMIC_ACQUIRE);
+    ArenaBlock* current = arena->head;
+    ArenaBlock* pending = NULL;
+
+    // Sort the queue in place, then free it in one pass over the blocks
+    for (p = arena_sort_remote(p); p; p = arena_remote_next(p)) {
+        arena_sweep_free(arena, &current, &pending, (size_t) ((char*) p - (char*) arena->mem));
+    }
+
+    if (pending) {
+        arena_trim_block(arena, pending);
+    }
+}
+
+/**
+ * @brief Retrieves the tag associated with a memory block.
+ *
+ * This function can only be used if the arena is in managed mode.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param p Pointer to the memory block.
+ * @return The tag of the block, or ARENA_FAILURE if the block is not found.
+ */
+int arena_get_tag(Arena* arena, void* p) {
+    if (!arena->managed) {
+        return ARENA_FAILURE;
+    }
+
+    ArenaBlock* block = arena_get_block(arena, p);
+    if (block) {
+        return block->tag;
+    }
+    return ARENA_FAILURE;
+}
+
+/**
+ * @brief Sets the tag for a memory block.
+ *
+ * This function can only be used if the arena is in managed mode.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param p Pointer to the memory block.
+ * @param tag The tag value to set.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the block is not found.
+ */
+int arena_set_tag(Arena* arena, void* p, int tag) {
+    if (!arena->managed) {
+        return ARENA_FAILURE;
+    }
+
+    ArenaBlock* block = arena_get_block(arena, p);
+    if (block) {
+        block->tag = tag;
+        return ARENA_SUCCESS;
+    }
+
+    return ARENA_FAILURE;
+}
+
+/**
+ * @brief Frees all memory blocks with the specified tag.
+ *
+ * This function can only be used if the arena is in managed mode.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param tag The tag value to collect.
+ */
+void arena_collect_tag(Arena* arena, int tag) {
+    if (!arena->managed) {
+        return;
+    }
+
+    ArenaBlock* block;
+    while ((block = arena_get_block_by_tag(arena, tag, 0))) {
+        arena_free_block(arena, block);
+    }
+}
+
+/**
+ * @brief Retrieves the n-th block with the specified tag.
+ *
+ * This function can only be used if the arena is in managed mode.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param tag The tag value to search for.
+ * @param n The index of the block to retrieve.
+ * @return Pointer to the n-th ArenaBlock with the specified tag, or NULL if not found.
+ */
+ArenaBlock* arena_get_block_by_tag(Arena* arena, int tag, int n) {
+    if (!arena->managed) {
+        return NULL;
     }
 
     int count = 0;
-    for (size_t i = 0; i < arena->maxBlocks; i++) {
+    for (size_t i = 0; i < arena->blockCount; i++) {
         ArenaBlock* block = &arena->head[i];
         if (block->tag == tag && block->status == ARENA_STATUS_USED) {
             if (count == n) {
@@ -499,13 +1071,792 @@ static ArenaBlock* arena_find_empty_block(Arena* arena) {
     }
 
     ArenaBlock* current = arena->head;
-    size_t      count   = 0;
-
-    for (size_t i = 0; i < arena->maxBlocks; i++) {
+    for (size_t i = 0; i < arena->blockCount; i++) {
         if (current->status == ARENA_STATUS_UNDEFINED) {
             return current;
         }
         current++;
     }
+
+    if (arena->blockCount < arena->maxBlocks) {
+        // Descriptors past the high-water mark are undefined whatever they contain
+        return &arena->head[arena->blockCount++];
+    }
     return NULL;
 }
+
+/**
+ * @brief Returns a block descriptor to the pool of empty descriptors.
+ *
+ * @param block Pointer to the ArenaBlock to release.
+ */
+static void arena_release_block(ArenaBlock* block) {
+    block->idx    = -1;
+    block->size   = 0;
+    block->tag    = ARENA_TAG_NONE;
+    block->status = ARENA_STATUS_UNDEFINED;
+    block->next   = NULL;
+    block->prev   = NULL;
+}
+
+/**
+ * @brief Marks a block free and merges it with its free neighbours.
+ *
+ * @param block Pointer to the ArenaBlock to free.
+ * @return Pointer to the free block now containing the given block.
+ */
+static ArenaBlock* arena_coalesce_block(ArenaBlock* block) {
+    ArenaBlock* tmp;
+    block->status = ARENA_STATUS_FREE;
+    block->tag    = ARENA_TAG_NONE;
+
+    if (block->next != NULL && block->next->status == ARENA_STATUS_FREE) {
+        tmp = block->next;
+        block->size += tmp->size;
+        block->next = tmp->next;
+        if (block->next) {
+            block->next->prev = block;
+        }
+        arena_release_block(tmp);
+    }
+
+    if (block->prev != NULL && block->prev->status == ARENA_STATUS_FREE) {
+        // Fold into the previous block so the list head never moves
+        tmp = block;
+        block = block->prev;
+        block->size += tmp->size;
+        block->next = tmp->next;
+        if (block->next) {
+            block->next->prev = block;
+        }
+        arena_release_block(tmp);
+    }
+
+    return block;
+}
+
+/**
+ * @brief Returns the pages of a free block to the OS if it reaches the arena's trim threshold.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param block Pointer to the free ArenaBlock.
+ */
+static void arena_trim_block(Arena* arena, ArenaBlock* block) {
+    if (arena->trimThreshold && block->size >= arena->trimThreshold) {
+        arena_release_pages(arena, block->idx, block->idx + block->size);
+    }
+}
+
+/**
+ * @brief Sorts pointers by address in place with a most significant digit radix sort.
+ *
+ * Each pass permutes the pointers into 256 buckets by one byte of their offset from base, then
+ * sorts each bucket on the next byte down. Short runs are insertion sorted.
+ *
+ * @param ptrs Array of pointers to sort, all at or above base.
+ * @param n Number of pointers.
+ * @param base Address the offsets are taken from.
+ * @param shift Bit position of the byte to sort on, a multiple of 8.
+ */
+static void arena_sort_ptrs(void** ptrs, size_t n, uintptr_t base, unsigned shift) {
+    size_t next[256] = { 0 };
+    size_t end[256];
+    size_t total = 0;
+
+    if (n <= ARENA_SORT_MIN) {
+        for (size_t i = 1; i < n; i++) {
+            void*  p = ptrs[i];
+            size_t j = i;
+            for (; j > 0 && (uintptr_t) ptrs[j - 1] > (uintptr_t) p; j--) {
+                ptrs[j] = ptrs[j - 1];
+            }
+            ptrs[j] = p;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        next[(((uintptr_t) ptrs[i] - base) >> shift) & 0xFF]++;
+    }
+    for (size_t d = 0; d < 256; d++) {
+        size_t c = next[d];
+        next[d]  = total;
+        total += c;
+        end[d] = total;
+    }
+
+    // Follow each displaced pointer to its bucket until one belonging here turns up
+    for (size_t d = 0; d < 256; d++) {
+        while (next[d] < end[d]) {
+            void*  p     = ptrs[next[d]];
+            size_t digit = (((uintptr_t) p - base) >> shift) & 0xFF;
+            while (digit != d) {
+                void* displaced     = ptrs[next[digit]];
+                ptrs[next[digit]++] = p;
+                p                   = displaced;
+                digit               = (((uintptr_t) p - base) >> shift) & 0xFF;
+            }
+            ptrs[next[d]++] = p;
+        }
+    }
+
+    if (shift == 0) {
+        return;
+    }
+    for (size_t d = 0, start = 0; d < 256; start = end[d++]) {
+        arena_sort_ptrs(ptrs + start, end[d] - start, base, shift - 8);
+    }
+}
+
+/**
+ * @brief Frees the block at the given offset during an address-ordered sweep of the blocks.
+ *
+ * Offsets must be passed in ascending order. Trimming is deferred until the sweep leaves a run of
+ * merged free blocks.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param current Block to continue the sweep from, advanced past the freed block.
+ * @param pending Free block awaiting trimming, or NULL.
+ * @param idx Offset of the block to free.
+ * @return true if a used block started at the offset and was freed, false otherwise.
+ */
+static bool arena_sweep_free(Arena* arena, ArenaBlock** current, ArenaBlock** pending, size_t idx) {
+    ArenaBlock* block = *current;
+
+    while (block && block->idx < idx) {
+        block = block->next;
+    }
+    *current = block;
+
+    if (!block || block->idx != idx || block->status != ARENA_STATUS_USED) {
+        // Not a block, or already freed earlier in the sweep
+        return false;
+    }
+
+    ArenaBlock* merged = arena_coalesce_block(block);
+    if (*pending && *pending != merged) {
+        arena_trim_block(arena, *pending);
+    }
+    *pending = merged;
+    *current = merged->next;
+    return true;
+}
+
+/**
+ * @brief Reads the link stored at the start of a block queued by arena_free_remote().
+ *
+ * @param p Pointer to the queued block.
+ * @return Pointer to the next queued block, or NULL.
+ */
+static void* arena_remote_next(void* p) {
+    void* next;
+    memcpy(&next, p, sizeof(next));
+    return next;
+}
+
+/**
+ * @brief Writes the link stored at the start of a block queued by arena_free_remote().
+ *
+ * @param p Pointer to the queued block.
+ * @param next Pointer to the next queued block, or NULL.
+ */
+static void arena_remote_link(void* p, void* next) { memcpy(p, &next, sizeof(next)); }
+
+/**
+ * @brief Merges two address-ordered lists of queued blocks.
+ *
+ * @param a First sorted list, or NULL.
+ * @param b Second sorted list, or NULL.
+ * @return The merged sorted list.
+ */
+static void* arena_merge_remote(void* a, void* b) {
+    void* head = NULL;
+    void* tail = NULL;
+
+    while (a || b) {
+        void* next;
+        if (!b || (a && (size_t) a < (size_t) b)) {
+            next = a;
+            a    = arena_remote_next(a);
+        } else {
+            next = b;
+            b    = arena_remote_next(b);
+        }
+
+        if (tail) {
+            arena_remote_link(tail, next);
+        } else {
+            head = next;
+        }
+        tail = next;
+    }
+
+    return head;
+}
+
+/**
+ * @brief Sorts a list of queued blocks by address with a bottom-up merge sort.
+ *
+ * The sort only relinks the blocks, so it needs no memory beyond a fixed array of runs.
+ *
+ * @param list List of blocks queued by arena_free_remote().
+ * @return The sorted list.
+ */
+static void* arena_sort_remote(void* list) {
+    void*  runs[sizeof(size_t) * 8] = { NULL };
+    void*  sorted                   = NULL;
+    size_t used                     = 0;
+
+    while (list) {
+        void*  run = list;
+        size_t i   = 0;
+
+        list = arena_remote_next(list);
+        arena_remote_link(run, NULL);
+
+        // runs[i] holds 2^i blocks, so merging carries like a binary counter
+        for (; i < used && runs[i]; i++) {
+            run     = arena_merge_remote(runs[i], run);
+            runs[i] = NULL;
+        }
+        runs[i] = run;
+        if (i == used) {
+            used++;
+        }
+    }
+
+    for (size_t i = 0; i < used; i++) {
+        sorted = arena_merge_remote(runs[i], sorted);
+    }
+    return sorted;
+}
+
+/**
+ * @brief Shrinks a block to the given size, moving the remainder into a new free block.
+ *
+ * The new free block is linked directly after the given block.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param block Pointer to the ArenaBlock to split.
+ * @param size New size of the block, which must be less than its current size.
+ * @return true on success, false if no empty descriptor is available.
+ */
+static bool arena_split_block(Arena* arena, ArenaBlock* block, size_t size) {
+    ArenaBlock* newNext = arena_find_empty_block(arena);
+    if (!newNext) {
+        return false;
+    }
+
+    newNext->idx    = block->idx + size;
+    newNext->size   = block->size - size;
+    newNext->status = ARENA_STATUS_FREE;
+    newNext->tag    = ARENA_TAG_NONE;
+    newNext->prev   = block;
+    newNext->next   = block->next;
+    if (block->next) {
+        block->next->prev = newNext;
+    }
+
+    block->next = newNext;
+    block->size = size;
+    return true;
+}
+
+/**
+ * @brief Grows a block in place by taking space from the free block that follows it.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param block Pointer to the ArenaBlock to grow.
+ * @param size New size of the block, which must be greater than its current size.
+ * @return true if the block was grown, false if there is not enough free space after it.
+ */
+static bool arena_grow_block(Arena* arena, ArenaBlock* block, size_t size) {
+    ArenaBlock* next  = block->next;
+    size_t      delta = size - block->size;
+
+    if (!next || next->status != ARENA_STATUS_FREE || next->size < delta) {
+        return false;
+    }
+
+    if (next->size == delta) {
+        block->next = next->next;
+        if (block->next) {
+            block->next->prev = block;
+        }
+        arena_release_block(next);
+    } else {
+        next->idx += delta;
+        next->size -= delta;
+    }
+
+    arena_prepare_range(arena, (char*) ARENA_PTR(arena, block) + block->size, delta, false);
+    block->size = size;
+    return true;
+}
+
+/**
+ * @brief Finds a free block of the given size and marks it used, without preparing its memory.
+ *
+ * If the alignment requires padding at the start of a free block, the padding is split off into a
+ * separate free block.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param size Size of the memory block to allocate.
+ * @param alignment Required alignment of the block's address, a power of two.
+ * @return Pointer to the allocated ArenaBlock, or NULL if allocation fails.
+ */
+static ArenaBlock* arena_take_block(Arena* arena, size_t size, size_t alignment) {
+    if (__atomic_load_n(&arena->remoteFree, __ATOMIC_RELAXED)) {
+        arena_collect_remote(arena);
+    }
+
+    ArenaBlock* current = arena->head;
+    while (current) {
+        if (current->status == ARENA_STATUS_FREE && current->size >= size) {
+            size_t addr = (size_t) ARENA_PTR(arena, current);
+            size_t pad  = ((addr + alignment - 1) & ~(alignment - 1)) - addr;
+
+            if (pad == 0 || current->size - size >= pad) {
+                if (pad > 0) {
+                    if (!arena_split_block(arena, current, pad)) {
+                        // Out of descriptors
+                        return NULL;
+                    }
+                    current = current->next;
+                }
+                if (current->size > size && !arena_split_block(arena, current, size)) {
+                    // Out of descriptors
+                    return NULL;
+                }
+                current->status = ARENA_STATUS_USED;
+                return current;
+            }
+        }
+        current = current->next;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Allocates memory in either mode, without preparing it.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param size Size of the memory block to allocate.
+ * @param alignment Required alignment of the memory's address, a power of two.
+ * @return Pointer to the allocated memory, or NULL if allocation fails.
+ */
+static void* arena_take(Arena* arena, size_t size, size_t alignment) {
+    if (!arena->managed) {
+        size_t addr    = (size_t) arena->ptr;
+        size_t pad     = ((addr + alignment - 1) & ~(alignment - 1)) - addr;
+        size_t oldSize = addr - (size_t) (arena->mem);
+        if (pad > arena->size - oldSize || size > arena->size - oldSize - pad) {
+            return NULL;
+        }
+        arena->ptr = (char*) arena->ptr + pad + size;
+        return (char*) arena->ptr - size;
+    }
+
+    ArenaBlock* block = arena_take_block(arena, size, alignment);
+    if (!block) {
+        return NULL;
+    }
+
+    return ARENA_PTR(arena, block);
+}
+
+/**
+ * @brief Retrieves the system page size.
+ *
+ * @return The page size in bytes.
+ */
+static size_t arena_page_size(void) {
+    static size_t pageSize = 0;
+    if (!pageSize) {
+        pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    }
+    return pageSize;
+}
+
+/**
+ * @brief Returns the whole pages inside the given range of the arena to the OS.
+ *
+ * The contents of the released pages are lost. On Linux, they read back as zero, which is recorded
+ * in the arena's zero page bitmap. Pages already recorded as zero are skipped. This is best-effort
+ * and does nothing on platforms without madvise(), for copy-on-write arenas, for arenas opened
+ * from a file, or for arenas over caller-provided memory.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param start Index of the start of the range.
+ * @param end Index of the end of the range.
+ * @return Number of bytes released.
+ */
+static size_t arena_release_pages(Arena* arena, size_t start, size_t end) {
+#ifdef MADV_DONTNEED
+    if (arena->backing || arena->flags & (ARENA_FLAG_EXTERNAL | ARENA_FLAG_MAPPED)) {
+        // Pages of a file mapping, or memory the arena does not own, may not read back as zero
+        return 0;
+    }
+
+    size_t pageSize = arena_page_size();
+    size_t base     = (size_t) arena->mem;
+    size_t first    = (base + start + pageSize - 1) / pageSize;
+    size_t last     = (base + end) / pageSize;
+    size_t released = 0;
+
+    if (first >= last) {
+        return 0;
+    }
+
+#ifdef __linux__
+    if (!arena->zeroPages) {
+        size_t pageCount = (base + arena->size + pageSize - 1) / pageSize - base / pageSize;
+        arena->zeroPages = (unsigned char*) calloc((pageCount + 7) / 8, 1);
+    }
+#endif
+
+    if (!arena->zeroPages) {
+        madvise((void*) (first * pageSize), (last - first) * pageSize, MADV_DONTNEED);
+        return (last - first) * pageSize;
+    }
+
+    // Release each run of pages not already known to be zero
+    unsigned char* map    = arena->zeroPages;
+    size_t         offset = base / pageSize;
+    size_t         page   = first;
+    while (page < last) {
+        while (page < last && (map[(page - offset) / 8] & (1 << (page - offset) % 8))) {
+            page++;
+        }
+
+        size_t runStart = page;
+        while (page < last && !(map[(page - offset) / 8] & (1 << (page - offset) % 8))) {
+            map[(page - offset) / 8] |= 1 << (page - offset) % 8;
+            page++;
+        }
+
+        if (page > runStart) {
+            madvise((void*) (runStart * pageSize), (page - runStart) * pageSize, MADV_DONTNEED);
+            released += (page - runStart) * pageSize;
+        }
+    }
+    return released;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Prepares newly allocated memory for use.
+ *
+ * Pages overlapping the range are no longer known to be zero once they are handed out. If zero is
+ * true, the range is also cleared, skipping the pages that were known to be zero.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param p Pointer to the start of the range.
+ * @param size Size of the range in bytes.
+ * @param zero Whether the range must be cleared.
+ */
+static void arena_prepare_range(Arena* arena, void* p, size_t size, bool zero) {
+    if (!arena->zeroPages || size == 0) {
+        if (zero) {
+            arena_memzero(p, size);
+        }
+        return;
+    }
+
+    size_t pageSize = arena_page_size();
+    size_t offset   = (size_t) arena->mem / pageSize;
+    size_t addr     = (size_t) p;
+    size_t end      = addr + size;
+    size_t dirty    = addr;
+
+    while (addr < end) {
+        size_t page    = addr / pageSize;
+        size_t pageEnd = (page + 1) * pageSize;
+        if (pageEnd > end) {
+            pageEnd = end;
+        }
+
+        unsigned char* byte = &arena->zeroPages[(page - offset) / 8];
+        unsigned char  bit  = 1 << (page - offset) % 8;
+        if (*byte & bit) {
+            *byte &= ~bit;
+            // Clear the run of pages before this one in one go
+            if (zero && dirty < addr) {
+                arena_memzero((void*) dirty, addr - dirty);
+            }
+            dirty = pageEnd;
+        }
+        addr = pageEnd;
+    }
+
+    if (zero && dirty < end) {
+        arena_memzero((void*) dirty, end - dirty);
+    }
+}
+
+/**
+ * @brief Copies the bookkeeping of an arena into its clone.
+ *
+ * Block indices are relative to mem and are copied as-is. The descriptor links are rebased onto
+ * the clone's descriptor array.
+ *
+ * @param clone Pointer to the cloned Arena structure, with mem and head already allocated.
+ * @param arena Pointer to the original Arena structure.
+ */
+static void arena_clone_meta(Arena* clone, const Arena* arena) {
+    clone->idx           = arena->idx;
+    clone->blockCount    = arena->blockCount;
+    clone->trimThreshold = arena->trimThreshold;
+    clone->remoteFree    = NULL;
+
+    if (!arena->managed) {
+        clone->ptr = (char*) clone->mem + ((char*) arena->ptr - (char*) arena->mem);
+        return;
+    }
+
+    memcpy(clone->head, arena->head, sizeof(ArenaBlock) * arena->blockCount);
+    for (size_t i = 0; i < arena->blockCount; i++) {
+        if (arena->head[i].next) {
+            clone->head[i].next = clone->head + (arena->head[i].next - arena->head);
+        }
+        if (arena->head[i].prev) {
+            clone->head[i].prev = clone->head + (arena->head[i].prev - arena->head);
+        }
+    }
+}
+
+/**
+ * @brief Creates a zero-filled shared memory file of the given size.
+ *
+ * @param size Size of the file in bytes.
+ * @return Pointer to the new ArenaBacking with one reference, or NULL on failure.
+ */
+static ArenaBacking* arena_new_backing(size_t size) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    ArenaBacking* backing;
+
+    if (!(backing = (ArenaBacking*) malloc(sizeof(ArenaBacking)))) {
+        return NULL;
+    }
+
+    if ((backing->fd = (int) syscall(SYS_memfd_create, "arena", MFD_CLOEXEC)) < 0) {
+        free(backing);
+        return NULL;
+    }
+
+    if (ftruncate(backing->fd, (off_t) size) != 0) {
+        close(backing->fd);
+        free(backing);
+        return NULL;
+    }
+
+    backing->refs = 1;
+    return backing;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Allocates the memory of a copy-on-write arena as a shared mapping of a new memfd.
+ *
+ * On platforms without memfd, the arena falls back to regular memory and loses ARENA_FLAG_COW.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @return Pointer to the arena memory, or NULL on failure.
+ */
+static void* arena_map_backing(Arena* arena) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    ArenaBacking* backing;
+    void*         mem;
+
+    if (!(backing = arena_new_backing(arena->size))) {
+        return NULL;
+    }
+
+    mem = mmap(NULL, arena->size, PROT_READ | PROT_WRITE, MAP_SHARED, backing->fd, 0);
+    if (mem == MAP_FAILED) {
+        close(backing->fd);
+        free(backing);
+        return NULL;
+    }
+
+    arena->backing = backing;
+    return mem;
+#else
+    arena->flags &= ~ARENA_FLAG_COW;
+    return malloc(arena->size);
+#endif
+}
+
+/**
+ * @brief Frees the memory of an arena, dropping its reference to the backing file if it has one.
+ *
+ * @param arena Pointer to the Arena structure.
+ */
+static void arena_free_mem(Arena* arena) {
+    if (arena->flags & ARENA_FLAG_MAPPED) {
+        munmap(arena->mem, arena->size);
+        return;
+    }
+
+    if (!arena->backing) {
+        free(arena->mem);
+        return;
+    }
+
+    munmap(arena->mem, arena->size);
+    if (--arena->backing->refs == 0) {
+        close(arena->backing->fd);
+        free(arena->backing);
+    }
+    arena->backing = NULL;
+}
+
+/**
+ * @brief Makes the arena's backing file an immutable snapshot of its current contents.
+ *
+ * Afterwards, the arena is a private view of the snapshot and the snapshot may be mapped by clones.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE on failure.
+ */
+static int arena_freeze_backing(Arena* arena) {
+    ArenaBacking* backing = arena->backing;
+
+    if (!(arena->flags & ARENA_FLAG_SNAPSHOT)) {
+        // Shared view, the file already holds the current contents
+        return arena_remap_backing(arena, backing);
+    }
+
+    if (backing->refs == 1) {
+        // No other view depends on the snapshot, so it can be updated in place
+        if (arena_write_back(arena, backing->fd, false) != ARENA_SUCCESS) {
+            return ARENA_FAILURE;
+        }
+        return arena_remap_backing(arena, backing);
+    }
+
+    if (!(backing = arena_new_backing(arena->size))) {
+        return ARENA_FAILURE;
+    }
+
+    if (arena_write_back(arena, backing->fd, true) != ARENA_SUCCESS
+        || arena_remap_backing(arena, backing) != ARENA_SUCCESS) {
+        close(backing->fd);
+        free(backing);
+        return ARENA_FAILURE;
+    }
+
+    arena->backing->refs--;
+    arena->backing = backing;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Replaces the arena's mapping with a private view of the given backing file.
+ *
+ * The contents of the file must match the arena's current contents.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param backing Pointer to the ArenaBacking to map.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE on failure.
+ */
+static int arena_remap_backing(Arena* arena, ArenaBacking* backing) {
+    void* mem = mmap(
+        arena->mem, arena->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, backing->fd, 0);
+    if (mem == MAP_FAILED) {
+        return ARENA_FAILURE;
+    }
+
+    arena->flags |= ARENA_FLAG_SNAPSHOT;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Writes the arena's contents to a file.
+ *
+ * Unless all is true, only the pages of the arena's private view that differ from the file are
+ * written, as reported by /proc/self/pagemap. Every page is written if that is unavailable.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param fd File to write to.
+ * @param all Whether to write every page.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE on failure.
+ */
+static int arena_write_back(Arena* arena, int fd, bool all) {
+    uint64_t entries[ARENA_PAGEMAP_BATCH];
+    size_t   pageSize  = arena_page_size();
+    size_t   pageCount = (arena->size + pageSize - 1) / pageSize;
+    size_t   firstPage = (size_t) arena->mem / pageSize;
+    int      pagemap   = all ? -1 : open("/proc/self/pagemap", O_RDONLY);
+    int      result    = ARENA_SUCCESS;
+
+    for (size_t batch = 0; batch < pageCount && result == ARENA_SUCCESS;
+         batch += ARENA_PAGEMAP_BATCH) {
+        size_t count = pageCount - batch;
+        if (count > ARENA_PAGEMAP_BATCH) {
+            count = ARENA_PAGEMAP_BATCH;
+        }
+
+        size_t  want = count * sizeof(uint64_t);
+        ssize_t got  = -1;
+        if (pagemap >= 0) {
+            got = pread(pagemap, entries, want, (off_t) ((firstPage + batch) * sizeof(uint64_t)));
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (got == (ssize_t) want) {
+                // Present anonymous or swapped pages are private copies, the rest is the file
+                uint64_t entry    = entries[i];
+                bool     present  = (entry >> 63) & 1;
+                bool     swapped  = (entry >> 62) & 1;
+                bool     filePage = (entry >> 61) & 1;
+                if (!swapped && !(present && !filePage)) {
+                    continue;
+                }
+            }
+
+            size_t offset = (batch + i) * pageSize;
+            size_t len    = arena->size - offset < pageSize ? arena->size - offset : pageSize;
+            while (len > 0) {
+                ssize_t written = pwrite(fd, (char*) arena->mem + offset, len, (off_t) offset);
+                if (written < 0) {
+                    result = ARENA_FAILURE;
+                    break;
+                }
+                offset += written;
+                len -= written;
+            }
+        }
+    }
+
+    if (pagemap >= 0) {
+        close(pagemap);
+    }
+    return result;
+}
+
+/**
+ * @brief Converts a new allocation to a reference, undoing the allocation if it is out of reach.
+ *
+ * @param arena Pointer to the Arena structure.
+ * @param p Pointer to the new allocation, or NULL.
+ * @return Reference to p, or ARENA_REF_NULL if p is NULL or cannot be referenced.
+ */
+static ArenaRef arena_ref_or_undo(Arena* arena, void* p) {
+    ArenaRef ref = arena_ref(arena, p);
+
+    if (p != NULL && ref == ARENA_REF_NULL) {
+        if (arena->managed) {
+            arena_free(arena, p);
+        } else {
+            // The allocation is the top of the arena
+            arena->ptr = p;
+        }
+    }
+    return ref;
+}
@@ -3,9 +3,14 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #ifndef ARENA_VERSION
 /**
  * @brief Version of libarena
@@ -22,6 +27,15 @@ typedef enum {
     ARENA_STATUS_UNDEFINED = 2
 } ArenaStatus;
 
+/**
+ * @brief arena_reset_mode() page handling enum.
+ */
+typedef enum {
+    ARENA_RESET_KEEP    = 0, //!< Only reset bookkeeping. Committed pages stay resident.
+    ARENA_RESET_WARM    = 1, //!< Also pre-fault the pages below the threshold.
+    ARENA_RESET_RELEASE = 2 //!< Also return the pages above the threshold to the OS.
+} ArenaResetMode;
+
 /**
  * @brief No tag placeholder.
  */
@@ -37,6 +51,39 @@ typedef enum {
  */
 #define ARENA_FAILURE -1
 
+/**
+ * @brief arena_init_flags() flag enabling block management.
+ */
+#define ARENA_FLAG_MANAGED 0x0001
+
+/**
+ * @brief arena_init_flags() flag backing the arena with a shared memory file for copy-on-write
+ * cloning.
+ */
+#define ARENA_FLAG_COW 0x0002
+
+/**
+ * @brief Flag bits reserved for internal state.
+ */
+#define ARENA_FLAG_INTERNAL 0xFF00
+
+/**
+ * @brief Internal flag set on arenas whose storage is owned by the caller.
+ */
+#define ARENA_FLAG_EXTERNAL 0x0200
+
+#ifndef ARENA_STREAM_THRESHOLD
+/**
+ * @brief Default size from which the bulk memory kernels bypass the cache.
+ */
+#define ARENA_STREAM_THRESHOLD ((size_t) 1 << 20)
+#endif
+
+/**
+ * @brief Alignment of the memory handed out by arena_init_in() and the static arena macros.
+ */
+#define ARENA_ALIGNMENT 16
+
 /**
  * @brief Get pointer from ArenaBlock
  */
@@ -45,7 +92,41 @@ typedef enum {
 /**
  * @brief Copy data from src to dst
  */
-#define ARENA_COPY(arena, dst, src) memcpy(ARENA_PTR(arena, dst), ARENA_PTR(arena, src), src->size)
+#define ARENA_COPY(arena, dst, src)                                                                \
+    arena_memcpy(ARENA_PTR(arena, dst), ARENA_PTR(arena, src), src->size)
+
+/**
+ * @brief 32-bit reference to memory in an arena, relative to the start of the arena.
+ *
+ * A reference holds the offset from the arena's memory plus one, so that zeroed memory reads as
+ * ARENA_REF_NULL. References stay valid when the arena is cloned, dumped and reopened.
+ */
+typedef uint32_t ArenaRef;
+
+/**
+ * @brief Null reference.
+ */
+#define ARENA_REF_NULL ((ArenaRef) 0)
+
+/**
+ * @brief Largest offset into an arena that a reference can hold.
+ */
+#define ARENA_REF_MAX_OFFSET ((size_t) UINT32_MAX - 1)
+
+/**
+ * @brief Get ArenaRef from pointer, without checking that it points into the arena
+ */
+#define ARENA_REF(arena, p) ((ArenaRef) ((char*) (p) - (char*) (arena)->mem + 1))
+
+/**
+ * @brief Get pointer from ArenaRef, without checking for ARENA_REF_NULL
+ */
+#define ARENA_REF_PTR(arena, ref) ((void*) ((char*) (arena)->mem + ((size_t) (ref) - 1)))
+
+/**
+ * @brief Get typed pointer from ArenaRef, without checking for ARENA_REF_NULL
+ */
+#define ARENA_DEREF(arena, type, ref) ((type*) ARENA_REF_PTR(arena, ref))
 
 /**
  * @struct ArenaBlock
@@ -63,38 +144,118 @@ typedef struct arena_block_s {
     struct arena_block_s* prev; //!< A pointer to the previous block in the arena.
 } ArenaBlock;
 
+/**
+ * @brief Opaque shared memory file backing copy-on-write arenas.
+ */
+typedef struct arena_backing_s ArenaBacking;
+
 /**
  * @struct Arena
  * @brief Arena structure
  *
  * This structure represents an arena of memory.
  * It contains information about the arena's memory, pointer, head block, index, size, maximum
- * block count, and management status.
+ * block count, descriptor high-water mark, remote free queue, page trimming state, backing file,
+ * flags, and management status.
  */
 typedef struct {
-    void*       mem; //!< A pointer to the memory block of the arena.
-    void*       ptr; //!< A pointer to the current position in the memory block.
-    ArenaBlock* head; //!< A pointer to the head block of the arena.
-    size_t      idx; //!< The index of the current block within the arena.
-    size_t      size; //!< The size of the memory block in bytes.
-    size_t      maxBlocks; //!< The maximum number of blocks that can be allocated in the arena.
-    bool        managed; //!< A flag indicating whether the arena is managed or not.
+    void*          mem; //!< A pointer to the memory block of the arena.
+    void*          ptr; //!< A pointer to the current position in the memory block.
+    ArenaBlock*    head; //!< A pointer to the head block of the arena.
+    size_t         idx; //!< The index of the current block within the arena.
+    size_t         size; //!< The size of the memory block in bytes.
+    size_t         maxBlocks; //!< The maximum number of blocks that can be allocated in the arena.
+    size_t         blockCount; //!< The number of descriptors in use. The rest are undefined.
+    bool           managed; //!< A flag indicating whether the arena is managed or not.
+    int            flags; //!< The ARENA_FLAG_* flags the arena was created with.
+    ArenaBacking*  backing; //!< The file backing a copy-on-write arena, or NULL.
+    void*          remoteFree; //!< Blocks freed by other threads, not yet collected.
+    size_t         trimThreshold; //!< Free blocks this large are trimmed on free. 0 disables.
+    unsigned char* zeroPages; //!< Bitmap of pages known to read back as zero, or NULL.
 } Arena;
 
+/**
+ * @brief Declare a managed arena in static storage, needing no initialization at runtime
+ */
+#define ARENA_STATIC_MANAGED(name, memSize, blocks)                                                \
+    static union {                                                                                 \
+        unsigned char data[memSize];                                                               \
+        long double   align;                                                                       \
+    } name##_mem;                                                                                  \
+    static ArenaBlock name##_blocks[blocks] = {                                                    \
+        { 0, memSize, ARENA_TAG_NONE, ARENA_STATUS_FREE, NULL, NULL }                              \
+    };                                                                                             \
+    static Arena name##_arena = { .mem        = &name##_mem,                                       \
+                                  .ptr        = &name##_mem,                                       \
+                                  .head       = name##_blocks,                                     \
+                                  .size       = memSize,                                           \
+                                  .maxBlocks  = blocks,                                            \
+                                  .blockCount = 1,                                                 \
+                                  .managed    = true,                                              \
+                                  .flags      = ARENA_FLAG_MANAGED | ARENA_FLAG_EXTERNAL };        \
+    static Arena* const name = &name##_arena
+
+/**
+ * @brief Declare an unmanaged arena in static storage, needing no initialization at runtime
+ */
+#define ARENA_STATIC_UNMANAGED(name, memSize)                                                      \
+    static union {                                                                                 \
+        unsigned char data[memSize];                                                               \
+        long double   align;                                                                       \
+    } name##_mem;                                                                                  \
+    static Arena name##_arena = { .mem   = &name##_mem,                                            \
+                                  .ptr   = &name##_mem,                                            \
+                                  .size  = memSize,                                                \
+                                  .flags = ARENA_FLAG_EXTERNAL };                                  \
+    static Arena* const name = &name##_arena
+
 /* Init/deinit/helpers */
 Arena*      arena_init(size_t size, size_t blockCount, int managed);
+Arena*      arena_init_flags(size_t size, size_t blockCount, int flags);
+Arena*      arena_init_in(
+    void* buffer, size_t size, ArenaBlock* descriptors, size_t maxBlocks, int flags);
 int         arena_destroy(Arena* arena);
+Arena*      arena_clone(Arena* arena);
+int         arena_reset(Arena* arena);
+int         arena_reset_mode(Arena* arena, ArenaResetMode mode, size_t threshold);
+size_t      arena_trim(Arena* arena);
 ArenaBlock* arena_free_block(Arena* arena, ArenaBlock* block);
 ArenaBlock* arena_get_block(Arena* arena, void* p);
 ArenaBlock* arena_alloc(Arena* arena, size_t size);
 void        arena_dump(Arena* arena, FILE* f);
+Arena*      arena_open(const char* path);
 void        arena_print(Arena* arena);
 
 /* Standard memory management functions */
 void* arena_malloc(Arena* arena, size_t size);
+void* arena_memalign(Arena* arena, size_t alignment, size_t size);
 void* arena_calloc(Arena* arena, size_t size, size_t num);
 void* arena_realloc(Arena* arena, void* p, size_t size);
+void* arena_resize(Arena* arena, void* p, size_t oldSize, size_t size);
 int   arena_free(Arena* arena, void* p);
+int   arena_free_batch(Arena* arena, void** ptrs, size_t n, int* status);
+
+/* Arena-relative references */
+ArenaRef arena_ref(Arena* arena, const void* p);
+void*    arena_deref(Arena* arena, ArenaRef ref);
+ArenaRef arena_malloc_ref(Arena* arena, size_t size);
+ArenaRef arena_calloc_ref(Arena* arena, size_t num, size_t size);
+ArenaRef arena_realloc_ref(Arena* arena, ArenaRef ref, size_t size);
+int      arena_free_ref(Arena* arena, ArenaRef ref);
+
+/* Cross-thread freeing */
+int  arena_free_remote(Arena* arena, void* p);
+void arena_collect_remote(Arena* arena);
+
+/* Bulk memory kernels */
+void*       arena_memcpy(void* dst, const void* src, size_t n);
+void*       arena_memset(void* dst, int c, size_t n);
+void*       arena_memzero(void* dst, size_t n);
+int         arena_memcmp(const void* a, const void* b, size_t n);
+void        arena_set_stream_threshold(size_t threshold);
+size_t      arena_get_stream_threshold(void);
+const char* arena_kernel_isa(void);
+int         arena_set_kernel_isa(const char* isa);
 
 /* Tagging stuff */
 int         arena_get_tag(Arena* arena, void* p);
@@ -105,4 +266,8 @@ void*       arena_get_ptr_by_tag(Arena* arena, int tag, int n);
 
 const char* arena_version();
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
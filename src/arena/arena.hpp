@@ -0,0 +1,97 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include "arena.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+/**
+ * @class ArenaResource
+ * @brief std::pmr::memory_resource backed by an Arena
+ *
+ * Allocations honour the requested alignment. Deallocation frees the block in managed mode and
+ * does nothing in unmanaged mode. The resource does not own the arena.
+ */
+class ArenaResource : public std::pmr::memory_resource {
+public:
+    explicit ArenaResource(Arena* arena) noexcept : arena_(arena) {}
+
+    Arena* arena() const noexcept { return arena_; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void* p = arena_memalign(arena_, alignment, bytes);
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    void do_deallocate(void* p, std::size_t /*bytes*/, std::size_t /*alignment*/) override {
+        if (arena_->managed) {
+            arena_free(arena_, p);
+        }
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        const ArenaResource* resource = dynamic_cast<const ArenaResource*>(&other);
+        return resource && resource->arena_ == arena_;
+    }
+
+    Arena* arena_;
+};
+
+/**
+ * @class ArenaAllocator
+ * @brief Standard allocator backed by an Arena
+ *
+ * Deallocation frees the block in managed mode and does nothing in unmanaged mode. Copies of the
+ * allocator, including rebound ones, allocate from the same arena.
+ */
+template <class T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena* arena) noexcept : arena_(arena) {}
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena_(other.arena()) {}
+
+    Arena* arena() const noexcept { return arena_; }
+
+    T* allocate(std::size_t n) {
+        if (n > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+
+        void* p = arena_memalign(arena_, alignof(T), n * sizeof(T));
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, std::size_t /*n*/) noexcept {
+        if (arena_->managed) {
+            arena_free(arena_, p);
+        }
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept {
+        return arena_ == other.arena();
+    }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+        return arena_ != other.arena();
+    }
+
+private:
+    Arena* arena_;
+};
+
+#endif
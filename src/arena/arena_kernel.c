@@ -0,0 +1,447 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ARENA_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+#ifdef ARENA_KERNEL_X86
+/**
+ * @brief Compile a kernel for the given instruction set, regardless of the compiler flags.
+ */
+#define ARENA_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/**
+ * @brief Bulk memory kernels for one instruction set.
+ */
+typedef struct {
+    const char* isa; //!< The name of the instruction set.
+    void (*copy)(void* dst, const void* src, size_t n); //!< Copies with non-temporal stores.
+    void (*fill)(void* dst, int c, size_t n); //!< Fills with non-temporal stores.
+} ArenaKernels;
+
+static const ArenaKernels* arena_find_kernels(const char* isa);
+static const ArenaKernels* arena_select_kernels(void);
+static const ArenaKernels* arena_kernels(void);
+static void                arena_copy_scalar(void* dst, const void* src, size_t n);
+static void                arena_fill_scalar(void* dst, int c, size_t n);
+
+#ifdef ARENA_KERNEL_X86
+static size_t arena_align_head(void* dst, size_t alignment, size_t n);
+static void   arena_copy_sse2(void* dst, const void* src, size_t n);
+static void   arena_fill_sse2(void* dst, int c, size_t n);
+ARENA_TARGET("avx2") static void arena_copy_avx2(void* dst, const void* src, size_t n);
+ARENA_TARGET("avx2") static void arena_fill_avx2(void* dst, int c, size_t n);
+ARENA_TARGET("avx512f") static void arena_copy_avx512(void* dst, const void* src, size_t n);
+ARENA_TARGET("avx512f") static void arena_fill_avx512(void* dst, int c, size_t n);
+
+static const ArenaKernels sse2Kernels = { "sse2", arena_copy_sse2, arena_fill_sse2 };
+static const ArenaKernels avx2Kernels = { "avx2", arena_copy_avx2, arena_fill_avx2 };
+static const ArenaKernels avx512Kernels = { "avx512f", arena_copy_avx512, arena_fill_avx512 };
+#endif
+
+static const ArenaKernels scalarKernels = { "scalar", arena_copy_scalar, arena_fill_scalar };
+
+static const ArenaKernels* kernels         = NULL;
+static size_t              streamThreshold = ARENA_STREAM_THRESHOLD;
+
+/**
+ * @brief Copies memory, bypassing the cache for large copies.
+ *
+ * Copies of at least the stream threshold use non-temporal stores, so they do not evict the
+ * caller's working set. Smaller copies use memcpy(). The regions must not overlap.
+ *
+ * @param dst Destination of the copy.
+ * @param src Source of the copy.
+ * @param n Number of bytes to copy.
+ * @return dst.
+ */
+void* arena_memcpy(void* dst, const void* src, size_t n) {
+    if (n < arena_get_stream_threshold()) {
+        return memcpy(dst, src, n);
+    }
+
+    arena_kernels()->copy(dst, src, n);
+    return dst;
+}
+
+/**
+ * @brief Fills memory with a byte, bypassing the cache for large fills.
+ *
+ * Fills of at least the stream threshold use non-temporal stores. Smaller fills use memset().
+ *
+ * @param dst Memory to fill.
+ * @param c Byte to fill with, converted to unsigned char.
+ * @param n Number of bytes to fill.
+ * @return dst.
+ */
+void* arena_memset(void* dst, int c, size_t n) {
+    if (n < arena_get_stream_threshold()) {
+        return memset(dst, c, n);
+    }
+
+    arena_kernels()->fill(dst, c, n);
+    return dst;
+}
+
+/**
+ * @brief Zeroes memory, bypassing the cache for large ranges.
+ *
+ * @param dst Memory to zero.
+ * @param n Number of bytes to zero.
+ * @return dst.
+ */
+void* arena_memzero(void* dst, size_t n) { return arena_memset(dst, 0, n); }
+
+/**
+ * @brief Compares memory like memcmp().
+ *
+ * Comparisons only load, so there is no cache traffic to avoid, and the C library's memcmp() is
+ * already vectorized. It measured faster than dedicated SSE2, AVX2 and AVX-512 kernels at every
+ * size, so this calls it directly.
+ *
+ * @param a First region.
+ * @param b Second region.
+ * @param n Number of bytes to compare.
+ * @return Less than, equal to, or greater than zero as the first differing byte of a is less
+ * than, equal to, or greater than that of b.
+ */
+int arena_memcmp(const void* a, const void* b, size_t n) { return memcmp(a, b, n); }
+
+/**
+ * @brief Sets the size from which arena_memcpy(), arena_memset() and arena_memzero() bypass the
+ * cache.
+ *
+ * arena_calloc(), arena_realloc(), arena_resize() and arena_clone() go through these kernels, so
+ * this also applies to them. SIZE_MAX disables non-temporal stores.
+ *
+ * @param threshold Size in bytes.
+ */
+void arena_set_stream_threshold(size_t threshold) {
+    __atomic_store_n(&streamThreshold, threshold, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the size from which the bulk memory kernels bypass the cache.
+ *
+ * @return Size in bytes.
+ */
+size_t arena_get_stream_threshold(void) {
+    return __atomic_load_n(&streamThreshold, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the instruction set the bulk memory kernels were selected for.
+ *
+ * @return "avx512f", "avx2", "sse2" or "scalar".
+ */
+const char* arena_kernel_isa(void) { return arena_kernels()->isa; }
+
+/**
+ * @brief Forces the bulk memory kernels for the given instruction set.
+ *
+ * This is meant for testing and benchmarking. It must not be called while other threads use
+ * the kernels.
+ *
+ * @param isa "avx512f", "avx2", "sse2", "scalar", or NULL to select the best supported again.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the CPU does not support the instruction set.
+ */
+int arena_set_kernel_isa(const char* isa) {
+    const ArenaKernels* selected = isa ? arena_find_kernels(isa) : arena_select_kernels();
+
+    if (!selected) {
+        return ARENA_FAILURE;
+    }
+    __atomic_store_n(&kernels, selected, __ATOMIC_RELEASE);
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Finds the kernels for an instruction set, if the running CPU supports it.
+ *
+ * @param isa Name of the instruction set.
+ * @return Pointer to the kernels, or NULL if they are unknown or unsupported.
+ */
+static const ArenaKernels* arena_find_kernels(const char* isa) {
+    if (strcmp(isa, scalarKernels.isa) == 0) {
+        return &scalarKernels;
+    }
+
+#ifdef ARENA_KERNEL_X86
+    __builtin_cpu_init();
+    if (strcmp(isa, sse2Kernels.isa) == 0) {
+        return &sse2Kernels;
+    }
+    if (strcmp(isa, avx2Kernels.isa) == 0 && __builtin_cpu_supports("avx2")) {
+        return &avx2Kernels;
+    }
+    if (strcmp(isa, avx512Kernels.isa) == 0 && __builtin_cpu_supports("avx512f")) {
+        return &avx512Kernels;
+    }
+#endif
+    return NULL;
+}
+
+/**
+ * @brief Selects the best kernels supported by the running CPU.
+ *
+ * @return Pointer to the selected kernels.
+ */
+static const ArenaKernels* arena_select_kernels(void) {
+#ifdef ARENA_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return &avx512Kernels;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return &avx2Kernels;
+    }
+    return &sse2Kernels;
+#else
+    return &scalarKernels;
+#endif
+}
+
+/**
+ * @brief Gets the kernels for the running CPU, selecting them on first use.
+ *
+ * @return Pointer to the selected kernels.
+ */
+static const ArenaKernels* arena_kernels(void) {
+    const ArenaKernels* selected = __atomic_load_n(&kernels, __ATOMIC_ACQUIRE);
+
+    if (!selected) {
+        // Racing threads select the same kernels
+        selected = arena_select_kernels();
+        __atomic_store_n(&kernels, selected, __ATOMIC_RELEASE);
+    }
+    return selected;
+}
+
+/**
+ * @brief Copies memory with memcpy(), for CPUs without non-temporal stores.
+ *
+ * @param dst Destination of the copy.
+ * @param src Source of the copy.
+ * @param n Number of bytes to copy.
+ */
+static void arena_copy_scalar(void* dst, const void* src, size_t n) { memcpy(dst, src, n); }
+
+/**
+ * @brief Fills memory with memset(), for CPUs without non-temporal stores.
+ *
+ * @param dst Memory to fill.
+ * @param c Byte to fill with.
+ * @param n Number of bytes to fill.
+ */
+static void arena_fill_scalar(void* dst, int c, size_t n) { memset(dst, c, n); }
+
+#ifdef ARENA_KERNEL_X86
+/**
+ * @brief Gets the number of bytes before the next aligned address, capped at n.
+ *
+ * Non-temporal stores need aligned addresses, so the kernels store these bytes normally.
+ *
+ * @param dst Start of the destination.
+ * @param alignment Required alignment, a power of two.
+ * @param n Size of the destination.
+ * @return Number of bytes to store before the first aligned address.
+ */
+static size_t arena_align_head(void* dst, size_t alignment, size_t n) {
+    size_t head = (alignment - ((uintptr_t) dst & (alignment - 1))) & (alignment - 1);
+    return head < n ? head : n;
+}
+
+/**
+ * @brief Copies memory with 16-byte non-temporal stores.
+ *
+ * @param dst Destination of the copy.
+ * @param src Source of the copy.
+ * @param n Number of bytes to copy.
+ */
+static void arena_copy_sse2(void* dst, const void* src, size_t n) {
+    unsigned char*       d    = (unsigned char*) dst;
+    const unsigned char* s    = (const unsigned char*) src;
+    size_t               head = arena_align_head(d, 16, n);
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*) s);
+        __m128i b = _mm_loadu_si128((const __m128i*) (s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*) (s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*) (s + 48));
+        _mm_stream_si128((__m128i*) d, a);
+        _mm_stream_si128((__m128i*) (d + 16), b);
+        _mm_stream_si128((__m128i*) (d + 32), c);
+        _mm_stream_si128((__m128i*) (d + 48), e);
+    }
+    for (; n >= 16; n -= 16, d += 16, s += 16) {
+        _mm_stream_si128((__m128i*) d, _mm_loadu_si128((const __m128i*) s));
+    }
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+/**
+ * @brief Fills memory with 16-byte non-temporal stores.
+ *
+ * @param dst Memory to fill.
+ * @param c Byte to fill with.
+ * @param n Number of bytes to fill.
+ */
+static void arena_fill_sse2(void* dst, int c, size_t n) {
+    unsigned char* d     = (unsigned char*) dst;
+    size_t         head  = arena_align_head(d, 16, n);
+    __m128i        value = _mm_set1_epi8((char) c);
+
+    memset(d, c, head);
+    d += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, d += 64) {
+        _mm_stream_si128((__m128i*) d, value);
+        _mm_stream_si128((__m128i*) (d + 16), value);
+        _mm_stream_si128((__m128i*) (d + 32), value);
+        _mm_stream_si128((__m128i*) (d + 48), value);
+    }
+    for (; n >= 16; n -= 16, d += 16) {
+        _mm_stream_si128((__m128i*) d, value);
+    }
+    _mm_sfence();
+    memset(d, c, n);
+}
+
+/**
+ * @brief Copies memory with 32-byte non-temporal stores.
+ *
+ * @param dst Destination of the copy.
+ * @param src Source of the copy.
+ * @param n Number of bytes to copy.
+ */
+ARENA_TARGET("avx2") static void arena_copy_avx2(void* dst, const void* src, size_t n) {
+    unsigned char*       d    = (unsigned char*) dst;
+    const unsigned char* s    = (const unsigned char*) src;
+    size_t               head = arena_align_head(d, 32, n);
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= 128; n -= 128, d += 128, s += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) s);
+        __m256i b = _mm256_loadu_si256((const __m256i*) (s + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (s + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i*) (s + 96));
+        _mm256_stream_si256((__m256i*) d, a);
+        _mm256_stream_si256((__m256i*) (d + 32), b);
+        _mm256_stream_si256((__m256i*) (d + 64), c);
+        _mm256_stream_si256((__m256i*) (d + 96), e);
+    }
+    for (; n >= 32; n -= 32, d += 32, s += 32) {
+        _mm256_stream_si256((__m256i*) d, _mm256_loadu_si256((const __m256i*) s));
+    }
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+/**
+ * @brief Fills memory with 32-byte non-temporal stores.
+ *
+ * @param dst Memory to fill.
+ * @param c Byte to fill with.
+ * @param n Number of bytes to fill.
+ */
+ARENA_TARGET("avx2") static void arena_fill_avx2(void* dst, int c, size_t n) {
+    unsigned char* d     = (unsigned char*) dst;
+    size_t         head  = arena_align_head(d, 32, n);
+    __m256i        value = _mm256_set1_epi8((char) c);
+
+    memset(d, c, head);
+    d += head;
+    n -= head;
+
+    for (; n >= 128; n -= 128, d += 128) {
+        _mm256_stream_si256((__m256i*) d, value);
+        _mm256_stream_si256((__m256i*) (d + 32), value);
+        _mm256_stream_si256((__m256i*) (d + 64), value);
+        _mm256_stream_si256((__m256i*) (d + 96), value);
+    }
+    for (; n >= 32; n -= 32, d += 32) {
+        _mm256_stream_si256((__m256i*) d, value);
+    }
+    _mm_sfence();
+    memset(d, c, n);
+}
+
+/**
+ * @brief Copies memory with 64-byte non-temporal stores.
+ *
+ * @param dst Destination of the copy.
+ * @param src Source of the copy.
+ * @param n Number of bytes to copy.
+ */
+ARENA_TARGET("avx512f") static void arena_copy_avx512(void* dst, const void* src, size_t n) {
+    unsigned char*       d    = (unsigned char*) dst;
+    const unsigned char* s    = (const unsigned char*) src;
+    size_t               head = arena_align_head(d, 64, n);
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= 256; n -= 256, d += 256, s += 256) {
+        __m512i a = _mm512_loadu_si512((const void*) s);
+        __m512i b = _mm512_loadu_si512((const void*) (s + 64));
+        __m512i c = _mm512_loadu_si512((const void*) (s + 128));
+        __m512i e = _mm512_loadu_si512((const void*) (s + 192));
+        _mm512_stream_si512((void*) d, a);
+        _mm512_stream_si512((void*) (d + 64), b);
+        _mm512_stream_si512((void*) (d + 128), c);
+        _mm512_stream_si512((void*) (d + 192), e);
+    }
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+        _mm512_stream_si512((void*) d, _mm512_loadu_si512((const void*) s));
+    }
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+/**
+ * @brief Fills memory with 64-byte non-temporal stores.
+ *
+ * @param dst Memory to fill.
+ * @param c Byte to fill with.
+ * @param n Number of bytes to fill.
+ */
+ARENA_TARGET("avx512f") static void arena_fill_avx512(void* dst, int c, size_t n) {
+    unsigned char* d     = (unsigned char*) dst;
+    size_t         head  = arena_align_head(d, 64, n);
+    __m512i        value = _mm512_set1_epi32((int) (0x01010101u * (unsigned char) c));
+
+    memset(d, c, head);
+    d += head;
+    n -= head;
+
+    for (; n >= 256; n -= 256, d += 256) {
+        _mm512_stream_si512((void*) d, value);
+        _mm512_stream_si512((void*) (d + 64), value);
+        _mm512_stream_si512((void*) (d + 128), value);
+        _mm512_stream_si512((void*) (d + 192), value);
+    }
+    for (; n >= 64; n -= 64, d += 64) {
+        _mm512_stream_si512((void*) d, value);
+    }
+    _mm_sfence();
+    memset(d, c, n);
+}
+#endif
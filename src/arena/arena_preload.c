@@ -0,0 +1,574 @@
+/*
+ * LD_PRELOAD shim routing the C allocator through managed arenas.
+ *
+ *     LD_PRELOAD=libarena-preload.so ./program
+ *
+ * Each thread allocates from its own list of managed arenas ("chunks"), mapped directly from the
+ * OS and grown on demand. Every allocation is preceded by a small header holding its size and its
+ * offset from the start of the arena block. Chunks are aligned to ARENA_PRELOAD_SLOT bytes and
+ * registered in a radix map, so ownership of any pointer is found with two loads. Pointers not
+ * owned by a chunk are passed on to the C library's allocator. Blocks freed by a thread other than
+ * the chunk's owner go through arena_free_remote().
+ *
+ * When a thread exits, its empty chunks are unmapped and the rest are orphaned. Threads that run
+ * out of space adopt orphaned chunks, collecting their remote frees, before mapping new ones.
+ *
+ * The chunk size defaults to ARENA_PRELOAD_CHUNK_SIZE and may be overridden with the
+ * ARENA_PRELOAD_CHUNK_SIZE environment variable.
+ */
+#define _GNU_SOURCE
+
+#include "arena.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/**
+ * @brief Default size of a chunk in bytes.
+ */
+#define ARENA_PRELOAD_CHUNK_SIZE (4 << 20)
+
+/**
+ * @brief Alignment of chunks, and the granularity of the ownership map, as a shift.
+ */
+#define ARENA_PRELOAD_SLOT_SHIFT 22
+
+/**
+ * @brief Alignment of chunks in bytes.
+ */
+#define ARENA_PRELOAD_SLOT ((size_t) 1 << ARENA_PRELOAD_SLOT_SHIFT)
+
+/**
+ * @brief Number of user address bits covered by the ownership map.
+ */
+#define ARENA_PRELOAD_ADDRESS_BITS 47
+
+/**
+ * @brief Number of slot index bits resolved by each leaf of the ownership map.
+ */
+#define ARENA_PRELOAD_LEAF_BITS 12
+
+/**
+ * @brief Number of slot index bits resolved by the root of the ownership map.
+ */
+#define ARENA_PRELOAD_ROOT_BITS                                                                    \
+    (ARENA_PRELOAD_ADDRESS_BITS - ARENA_PRELOAD_SLOT_SHIFT - ARENA_PRELOAD_LEAF_BITS)
+
+/**
+ * @brief Smallest possible arena block, a header and the smallest allocation.
+ */
+#define ARENA_PRELOAD_MIN_BLOCK (ARENA_PRELOAD_HEADER * 2)
+
+/**
+ * @brief Size of the header preceding every allocation, which is also the minimum alignment.
+ */
+#define ARENA_PRELOAD_HEADER 16
+
+/**
+ * @struct ArenaPreloadHeader
+ * @brief Header stored directly before every allocation
+ */
+typedef struct {
+    size_t size; //!< The usable size of the allocation.
+    size_t offset; //!< The distance from the start of the arena block to the allocation.
+} ArenaPreloadHeader;
+
+/**
+ * @struct ArenaPreloadChunk
+ * @brief Managed arena mapped from the OS, owned by one thread
+ */
+typedef struct arena_preload_chunk_s {
+    Arena*                        arena; //!< The arena placed inside the chunk.
+    size_t                        owner; //!< The id of the heap allocating from the chunk, or 0.
+    size_t                        size; //!< The size of the mapping in bytes.
+    struct arena_preload_chunk_s* next; //!< The next chunk of the same heap.
+} ArenaPreloadChunk;
+
+/**
+ * @struct ArenaPreloadHeap
+ * @brief Per-thread list of chunks
+ */
+typedef struct {
+    ArenaPreloadChunk* chunks; //!< All chunks owned by the thread, most recent first.
+    ArenaPreloadChunk* current; //!< The chunk that served the last allocation.
+    size_t             id; //!< The id the thread's chunks are owned by, unique per thread, or 0.
+    bool               registered; //!< Whether the thread exit destructor is armed.
+} ArenaPreloadHeap;
+
+extern void* __libc_realloc(void* p, size_t size);
+extern void  __libc_free(void* p);
+
+static __thread ArenaPreloadHeap heap __attribute__((tls_model("initial-exec")));
+static ArenaPreloadChunk**       chunkMap[(size_t) 1 << ARENA_PRELOAD_ROOT_BITS];
+static int                       chunkMapLock;
+static size_t                    chunkSize;
+static ArenaPreloadChunk*        orphans;
+static size_t                    nextHeapId;
+static pthread_key_t             heapKey;
+static pthread_once_t            heapKeyOnce = PTHREAD_ONCE_INIT;
+
+static size_t             arena_preload_round(size_t size);
+static ArenaPreloadChunk* arena_preload_lookup(const void* p);
+static void               arena_preload_lock(void);
+static void               arena_preload_unlock(void);
+static int                arena_preload_register(ArenaPreloadChunk* chunk, ArenaPreloadChunk* owner);
+static bool               arena_preload_owned(const ArenaPreloadChunk* chunk);
+static void               arena_preload_create_key(void);
+static void               arena_preload_attach(ArenaPreloadChunk* chunk);
+static ArenaPreloadChunk* arena_preload_new_chunk(size_t size);
+static ArenaPreloadChunk* arena_preload_adopt(void);
+static void               arena_preload_release(ArenaPreloadChunk* chunk);
+static void               arena_preload_thread_exit(void* unused);
+static void*              arena_preload_alloc(size_t alignment, size_t size);
+static void               arena_preload_free(ArenaPreloadChunk* chunk, void* p);
+
+void* malloc(size_t size) { return arena_preload_alloc(ARENA_PRELOAD_HEADER, size); }
+
+void* calloc(size_t num, size_t size) {
+    if (size != 0 && num > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void* p = arena_preload_alloc(ARENA_PRELOAD_HEADER, num * size);
+    if (p) {
+        memset(p, 0, num * size);
+    }
+    return p;
+}
+
+void* realloc(void* p, size_t size) {
+    if (!p) {
+        return malloc(size);
+    }
+
+    ArenaPreloadChunk* chunk = arena_preload_lookup(p);
+    if (!chunk) {
+        return __libc_realloc(p, size);
+    }
+
+    if (size == 0) {
+        arena_preload_free(chunk, p);
+        return NULL;
+    }
+
+    if (size > SIZE_MAX - ARENA_PRELOAD_HEADER * 4) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    ArenaPreloadHeader* header = (ArenaPreloadHeader*) p - 1;
+    if (arena_preload_owned(chunk) && header->offset == ARENA_PRELOAD_HEADER) {
+        // Resize the arena block, in place when the next block is free
+        size_t blockSize = ARENA_PRELOAD_HEADER + arena_preload_round(size);
+        char*  block     = (char*) arena_realloc(chunk->arena, header, blockSize);
+        if (block) {
+            header       = (ArenaPreloadHeader*) block;
+            header->size = blockSize - ARENA_PRELOAD_HEADER;
+            return block + ARENA_PRELOAD_HEADER;
+        }
+    }
+
+    void* newP = malloc(size);
+    if (newP) {
+        memcpy(newP, p, header->size < size ? header->size : size);
+        arena_preload_free(chunk, p);
+    }
+    return newP;
+}
+
+void free(void* p) {
+    if (!p) {
+        return;
+    }
+
+    ArenaPreloadChunk* chunk = arena_preload_lookup(p);
+    if (!chunk) {
+        __libc_free(p);
+        return;
+    }
+    arena_preload_free(chunk, p);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    void* result = arena_preload_alloc(alignment, size);
+    if (!result) {
+        return ENOMEM;
+    }
+    *p = result;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return arena_preload_alloc(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size) { return aligned_alloc(alignment, size); }
+
+void* valloc(size_t size) { return arena_preload_alloc(4096, size); }
+
+size_t malloc_usable_size(void* p) {
+    static size_t (*next)(void*);
+
+    if (!p) {
+        return 0;
+    }
+
+    if (arena_preload_lookup(p)) {
+        return ((ArenaPreloadHeader*) p - 1)->size;
+    }
+
+    if (!next) {
+        *(void**) &next = dlsym(RTLD_NEXT, "malloc_usable_size");
+    }
+    return next ? next(p) : 0;
+}
+
+/**
+ * @brief Rounds an allocation size up to a non-zero multiple of the header size.
+ *
+ * Keeping every block a multiple of the header size keeps every block start aligned to it.
+ *
+ * @param size Size of the allocation in bytes, at most SIZE_MAX minus twice the header size.
+ * @return The rounded size.
+ */
+static size_t arena_preload_round(size_t size) {
+    if (size == 0) {
+        return ARENA_PRELOAD_HEADER;
+    }
+    return (size + ARENA_PRELOAD_HEADER - 1) & ~(size_t) (ARENA_PRELOAD_HEADER - 1);
+}
+
+/**
+ * @brief Finds the chunk owning the given pointer.
+ *
+ * @param p Pointer to look up.
+ * @return Pointer to the owning ArenaPreloadChunk, or NULL if the pointer is foreign.
+ */
+static ArenaPreloadChunk* arena_preload_lookup(const void* p) {
+    size_t addr = (size_t) p;
+    if (addr >> ARENA_PRELOAD_ADDRESS_BITS) {
+        return NULL;
+    }
+
+    size_t              slot = addr >> ARENA_PRELOAD_SLOT_SHIFT;
+    ArenaPreloadChunk** leaf
+        = __atomic_load_n(&chunkMap[slot >> ARENA_PRELOAD_LEAF_BITS], __ATOMIC_ACQUIRE);
+    if (!leaf) {
+        return NULL;
+    }
+    return __atomic_load_n(&leaf[slot & (((size_t) 1 << ARENA_PRELOAD_LEAF_BITS) - 1)],
+                           __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Takes the lock guarding the ownership map and the orphan list.
+ */
+static void arena_preload_lock(void) {
+    while (__atomic_test_and_set(&chunkMapLock, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+/**
+ * @brief Releases the lock guarding the ownership map and the orphan list.
+ */
+static void arena_preload_unlock(void) { __atomic_clear(&chunkMapLock, __ATOMIC_RELEASE); }
+
+/**
+ * @brief Records every slot of a chunk in the ownership map, or clears them.
+ *
+ * @param chunk Pointer to the ArenaPreloadChunk, which starts at its mapping.
+ * @param owner chunk to register it, or NULL to unregister it.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if a map leaf can't be allocated.
+ */
+static int arena_preload_register(ArenaPreloadChunk* chunk, ArenaPreloadChunk* owner) {
+    size_t first  = (size_t) chunk >> ARENA_PRELOAD_SLOT_SHIFT;
+    size_t last   = first + chunk->size / ARENA_PRELOAD_SLOT;
+    int    result = ARENA_SUCCESS;
+
+    arena_preload_lock();
+
+    for (size_t slot = first; slot < last && result == ARENA_SUCCESS; slot++) {
+        ArenaPreloadChunk*** root = &chunkMap[slot >> ARENA_PRELOAD_LEAF_BITS];
+        if (!*root) {
+            void* leaf = mmap(NULL,
+                              sizeof(ArenaPreloadChunk*) << ARENA_PRELOAD_LEAF_BITS,
+                              PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS,
+                              -1,
+                              0);
+            if (leaf == MAP_FAILED) {
+                result = ARENA_FAILURE;
+                break;
+            }
+            __atomic_store_n(root, (ArenaPreloadChunk**) leaf, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&(*root)[slot & (((size_t) 1 << ARENA_PRELOAD_LEAF_BITS) - 1)],
+                         owner,
+                         __ATOMIC_RELEASE);
+    }
+
+    arena_preload_unlock();
+    return result;
+}
+
+/**
+ * @brief Checks whether the calling thread allocates from the given chunk.
+ *
+ * Heap ids are never reused, so a chunk of an exited thread never matches a new thread whose
+ * heap has the same address.
+ *
+ * @param chunk Pointer to the ArenaPreloadChunk.
+ * @return true if the calling thread owns the chunk, false otherwise.
+ */
+static bool arena_preload_owned(const ArenaPreloadChunk* chunk) {
+    return heap.id != 0 && __atomic_load_n(&chunk->owner, __ATOMIC_RELAXED) == heap.id;
+}
+
+/**
+ * @brief Creates the key whose destructor releases a thread's chunks when it exits.
+ */
+static void arena_preload_create_key(void) {
+    pthread_key_create(&heapKey, arena_preload_thread_exit);
+}
+
+/**
+ * @brief Makes the calling thread the owner of a chunk, and the chunk its current one.
+ *
+ * @param chunk Pointer to the ArenaPreloadChunk, which must not be owned by any thread.
+ */
+static void arena_preload_attach(ArenaPreloadChunk* chunk) {
+    if (!heap.id) {
+        heap.id = __atomic_add_fetch(&nextHeapId, 1, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&chunk->owner, heap.id, __ATOMIC_RELAXED);
+    chunk->next  = heap.chunks;
+    heap.chunks  = chunk;
+    heap.current = chunk;
+
+    // Armed after the chunk is usable, in case pthread_setspecific() allocates
+    if (!heap.registered) {
+        heap.registered = true;
+        pthread_once(&heapKeyOnce, arena_preload_create_key);
+        pthread_setspecific(heapKey, &heap);
+    }
+}
+
+/**
+ * @brief Maps a new chunk for the calling thread, large enough for the given allocation.
+ *
+ * @param size Size of the arena block the chunk must be able to hold.
+ * @return Pointer to the new ArenaPreloadChunk, or NULL on failure.
+ */
+static ArenaPreloadChunk* arena_preload_new_chunk(size_t size) {
+    if (!chunkSize) {
+        const char* env = getenv("ARENA_PRELOAD_CHUNK_SIZE");
+        size_t      n   = env ? (size_t) strtoull(env, NULL, 0) : 0;
+        chunkSize       = n ? n : ARENA_PRELOAD_CHUNK_SIZE;
+    }
+
+    // Room for the chunk, the Arena and alignment padding
+    size_t overhead = sizeof(ArenaPreloadChunk) + sizeof(Arena) + ARENA_ALIGNMENT * 2;
+    if (size > SIZE_MAX - overhead - ARENA_PRELOAD_SLOT * 2) {
+        return NULL;
+    }
+
+    size_t mapSize = chunkSize > size + overhead ? chunkSize : size + overhead;
+    mapSize        = (mapSize + ARENA_PRELOAD_SLOT - 1) & ~(ARENA_PRELOAD_SLOT - 1);
+
+    // Over-map and trim so the chunk is aligned to a slot
+    char* raw = (char*) mmap(NULL,
+                             mapSize + ARENA_PRELOAD_SLOT,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS,
+                             -1,
+                             0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+
+    char* base = (char*) (((size_t) raw + ARENA_PRELOAD_SLOT - 1) & ~(ARENA_PRELOAD_SLOT - 1));
+    if (base > raw) {
+        munmap(raw, base - raw);
+    }
+    munmap(base + mapSize, raw + ARENA_PRELOAD_SLOT - base);
+
+    // Descriptors live in their own mapping, where only those in use are ever touched
+    size_t      maxBlocks = (mapSize < chunkSize ? mapSize : chunkSize) / ARENA_PRELOAD_MIN_BLOCK;
+    ArenaBlock* blocks    = (ArenaBlock*) mmap(NULL,
+                                            maxBlocks * sizeof(ArenaBlock),
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_PRIVATE | MAP_ANONYMOUS,
+                                            -1,
+                                            0);
+    if (blocks == MAP_FAILED) {
+        munmap(base, mapSize);
+        return NULL;
+    }
+
+    ArenaPreloadChunk* chunk = (ArenaPreloadChunk*) base;
+    chunk->owner             = 0;
+    chunk->size              = mapSize;
+    chunk->arena             = arena_init_in(base + sizeof(ArenaPreloadChunk),
+                                 mapSize - sizeof(ArenaPreloadChunk),
+                                 blocks,
+                                 maxBlocks,
+                                 ARENA_FLAG_MANAGED);
+    if (!chunk->arena || arena_preload_register(chunk, chunk) != ARENA_SUCCESS) {
+        munmap(blocks, maxBlocks * sizeof(ArenaBlock));
+        munmap(base, mapSize);
+        return NULL;
+    }
+
+    arena_preload_attach(chunk);
+    return chunk;
+}
+
+/**
+ * @brief Takes over a chunk orphaned by an exited thread, collecting its remote frees.
+ *
+ * @return Pointer to the adopted ArenaPreloadChunk, or NULL if there are no orphans.
+ */
+static ArenaPreloadChunk* arena_preload_adopt(void) {
+    ArenaPreloadChunk* chunk;
+
+    arena_preload_lock();
+    if ((chunk = orphans)) {
+        orphans = chunk->next;
+    }
+    arena_preload_unlock();
+
+    if (chunk) {
+        arena_preload_attach(chunk);
+        arena_collect_remote(chunk->arena);
+    }
+    return chunk;
+}
+
+/**
+ * @brief Unmaps an empty chunk and removes it from the ownership map.
+ *
+ * @param chunk Pointer to the ArenaPreloadChunk, which must hold no allocations.
+ */
+static void arena_preload_release(ArenaPreloadChunk* chunk) {
+    ArenaBlock* blocks    = chunk->arena->head;
+    size_t      maxBlocks = chunk->arena->maxBlocks;
+
+    arena_preload_register(chunk, NULL);
+    munmap(blocks, maxBlocks * sizeof(ArenaBlock));
+    munmap(chunk, chunk->size);
+}
+
+/**
+ * @brief Releases the chunks of an exiting thread.
+ *
+ * Chunks left empty once their remote frees are collected are unmapped. The others are orphaned
+ * for other threads to adopt, and blocks freed into them meanwhile queue up as remote frees.
+ *
+ * @param unused The value of the thread's key.
+ */
+static void arena_preload_thread_exit(void* unused) {
+    ArenaPreloadChunk* chunk = heap.chunks;
+
+    (void) unused;
+    heap.chunks     = NULL;
+    heap.current    = NULL;
+    heap.id         = 0;
+    heap.registered = false;
+
+    while (chunk) {
+        ArenaPreloadChunk* next  = chunk->next;
+        Arena*             arena = chunk->arena;
+
+        arena_collect_remote(arena);
+        if (arena->head->status == ARENA_STATUS_FREE && !arena->head->next) {
+            arena_preload_release(chunk);
+        } else {
+            __atomic_store_n(&chunk->owner, 0, __ATOMIC_RELAXED);
+            arena_preload_lock();
+            chunk->next = orphans;
+            orphans     = chunk;
+            arena_preload_unlock();
+        }
+        chunk = next;
+    }
+}
+
+/**
+ * @brief Allocates memory from the calling thread's chunks.
+ *
+ * @param alignment Required alignment, a power of two.
+ * @param size Size of the allocation in bytes.
+ * @return Pointer to the allocation, or NULL with errno set to ENOMEM on failure.
+ */
+static void* arena_preload_alloc(size_t alignment, size_t size) {
+    if (alignment < ARENA_PRELOAD_HEADER) {
+        alignment = ARENA_PRELOAD_HEADER;
+    }
+
+    // The header is placed in the last ARENA_PRELOAD_HEADER bytes of the leading alignment space
+    if (size > SIZE_MAX - alignment * 2) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t blockSize = alignment + arena_preload_round(size);
+
+    char*              block = NULL;
+    ArenaPreloadChunk* chunk = heap.current;
+    if (chunk) {
+        block = (char*) arena_memalign(chunk->arena, alignment, blockSize);
+    }
+
+    for (chunk = heap.chunks; !block && chunk; chunk = chunk->next) {
+        if (chunk != heap.current
+            && (block = (char*) arena_memalign(chunk->arena, alignment, blockSize))) {
+            heap.current = chunk;
+        }
+    }
+
+    while (!block && (chunk = arena_preload_adopt())) {
+        block = (char*) arena_memalign(chunk->arena, alignment, blockSize);
+    }
+
+    if (!block) {
+        if (!(chunk = arena_preload_new_chunk(blockSize + alignment))
+            || !(block = (char*) arena_memalign(chunk->arena, alignment, blockSize))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    ArenaPreloadHeader* header = (ArenaPreloadHeader*) (block + alignment) - 1;
+    header->size               = blockSize - alignment;
+    header->offset             = alignment;
+    return block + alignment;
+}
+
+/**
+ * @brief Frees an allocation owned by the given chunk.
+ *
+ * @param chunk Pointer to the ArenaPreloadChunk owning the allocation.
+ * @param p Pointer to the allocation.
+ */
+static void arena_preload_free(ArenaPreloadChunk* chunk, void* p) {
+    char* block = (char*) p - ((ArenaPreloadHeader*) p - 1)->offset;
+    if (arena_preload_owned(chunk)) {
+        arena_free(chunk->arena, block);
+    } else {
+        arena_free_remote(chunk->arena, block);
+    }
+}
@@ -0,0 +1,191 @@
+#include "arena_str.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Minimum capacity of a grown ArenaStr.
+ */
+#define ARENA_STR_MIN_CAP 15
+
+static int arena_str_grow(ArenaStr* str, size_t n);
+
+/**
+ * @brief Initializes an empty ArenaStr with a given capacity.
+ *
+ * @param str Pointer to the ArenaStr structure to initialize.
+ * @param arena Pointer to the Arena to allocate from.
+ * @param cap The number of characters to reserve space for.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the initial allocation fails or cap is
+ * SIZE_MAX.
+ */
+int arena_str_init(ArenaStr* str, Arena* arena, size_t cap) {
+    str->arena = arena;
+    str->data  = NULL;
+    str->len   = 0;
+    str->cap   = cap;
+
+    if (cap == SIZE_MAX || !(str->data = (char*) arena_malloc(arena, cap + 1))) {
+        return ARENA_FAILURE;
+    }
+    str->data[0] = '\0';
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Ensures the ArenaStr can hold at least cap characters.
+ *
+ * The allocation is grown in place when possible, and moved otherwise.
+ *
+ * @param str Pointer to the ArenaStr structure.
+ * @param cap The number of characters to reserve space for.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is out of space or cap is SIZE_MAX,
+ * leaving no room for the terminator.
+ */
+int arena_str_reserve(ArenaStr* str, size_t cap) {
+    if (cap <= str->cap) {
+        return ARENA_SUCCESS;
+    }
+    if (cap == SIZE_MAX) {
+        return ARENA_FAILURE;
+    }
+
+    char* data = (char*) arena_resize(str->arena, str->data, str->cap + 1, cap + 1);
+    if (!data) {
+        return ARENA_FAILURE;
+    }
+
+    str->data = data;
+    str->cap  = cap;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Appends n characters to the end of the ArenaStr.
+ *
+ * @param str Pointer to the ArenaStr structure.
+ * @param s Pointer to the characters to copy.
+ * @param n Number of characters to copy.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is out of space.
+ */
+int arena_str_append(ArenaStr* str, const char* s, size_t n) {
+    if (arena_str_grow(str, n) != ARENA_SUCCESS) {
+        return ARENA_FAILURE;
+    }
+
+    memcpy(str->data + str->len, s, n);
+    str->len += n;
+    str->data[str->len] = '\0';
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Appends a single character to the end of the ArenaStr.
+ *
+ * @param str Pointer to the ArenaStr structure.
+ * @param c Character to append.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is out of space.
+ */
+int arena_str_push(ArenaStr* str, char c) { return arena_str_append(str, &c, 1); }
+
+/**
+ * @brief Appends printf-style formatted output to the end of the ArenaStr.
+ *
+ * @param str Pointer to the ArenaStr structure.
+ * @param fmt Format string.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE on a formatting error or if the arena is out
+ * of space.
+ */
+int arena_str_format(ArenaStr* str, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int result = arena_str_vformat(str, fmt, args);
+    va_end(args);
+    return result;
+}
+
+/**
+ * @brief Appends vprintf-style formatted output to the end of the ArenaStr.
+ *
+ * @param str Pointer to the ArenaStr structure.
+ * @param fmt Format string.
+ * @param args Format arguments.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE on a formatting error or if the arena is out
+ * of space.
+ */
+int arena_str_vformat(ArenaStr* str, const char* fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int n = vsnprintf(str->data + str->len, str->cap - str->len + 1, fmt, copy);
+    va_end(copy);
+
+    if (n < 0) {
+        str->data[str->len] = '\0';
+        return ARENA_FAILURE;
+    }
+
+    if ((size_t) n > str->cap - str->len) {
+        // Didn't fit, grow and format again
+        if (arena_str_grow(str, n) != ARENA_SUCCESS) {
+            str->data[str->len] = '\0';
+            return ARENA_FAILURE;
+        }
+        vsnprintf(str->data + str->len, str->cap - str->len + 1, fmt, args);
+    }
+
+    str->len += n;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Shrinks the ArenaStr's allocation to fit its contents and returns the string.
+ *
+ * The ArenaStr may still be appended to afterwards.
+ *
+ * @param str Pointer to the ArenaStr structure.
+ * @return Pointer to the NUL-terminated string.
+ */
+char* arena_str_finish(ArenaStr* str) {
+    if (str->len < str->cap) {
+        char* data = (char*) arena_resize(str->arena, str->data, str->cap + 1, str->len + 1);
+        if (data) {
+            str->data = data;
+            str->cap  = str->len;
+        }
+    }
+
+    return str->data;
+}
+
+/**
+ * @brief Ensures there is room for n more characters, growing geometrically.
+ *
+ * @param str Pointer to the ArenaStr structure.
+ * @param n Number of characters to make room for.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is out of space or the length
+ * overflows.
+ */
+static int arena_str_grow(ArenaStr* str, size_t n) {
+    if (str->len + n < str->len) {
+        return ARENA_FAILURE;
+    }
+    if (str->len + n <= str->cap) {
+        return ARENA_SUCCESS;
+    }
+
+    size_t cap = str->cap > SIZE_MAX / 2 ? SIZE_MAX - 1 : str->cap * 2;
+    if (cap < ARENA_STR_MIN_CAP) {
+        cap = ARENA_STR_MIN_CAP;
+    }
+    if (cap < str->len + n) {
+        cap = str->len + n;
+    }
+
+    // Fall back to an exact fit if doubling does not fit in the arena
+    if (arena_str_reserve(str, cap) != ARENA_SUCCESS
+        && arena_str_reserve(str, str->len + n) != ARENA_SUCCESS) {
+        return ARENA_FAILURE;
+    }
+    return ARENA_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#ifndef ARENA_STR_H
+#define ARENA_STR_H
+
+#include "arena.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @struct ArenaStr
+ * @brief String builder structure
+ *
+ * This structure represents a NUL-terminated string being built inside an arena.
+ * When the string is the most recent allocation, or is followed by a free block, it grows in place.
+ */
+typedef struct {
+    Arena* arena; //!< The arena the string is allocated in.
+    char*  data; //!< A pointer to the NUL-terminated string.
+    size_t len; //!< The length of the string, not including the NUL terminator.
+    size_t cap; //!< The number of characters that fit, not including the NUL terminator.
+} ArenaStr;
+
+int   arena_str_init(ArenaStr* str, Arena* arena, size_t cap);
+int   arena_str_reserve(ArenaStr* str, size_t cap);
+int   arena_str_append(ArenaStr* str, const char* s, size_t n);
+int   arena_str_push(ArenaStr* str, char c);
+int   arena_str_format(ArenaStr* str, const char* fmt, ...);
+int   arena_str_vformat(ArenaStr* str, const char* fmt, va_list args);
+char* arena_str_finish(ArenaStr* str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+#include "arena_vec.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Minimum capacity of a non-empty ArenaVec.
+ */
+#define ARENA_VEC_MIN_CAP 8
+
+static size_t arena_vec_max_cap(const ArenaVec* vec);
+
+/**
+ * @brief Initializes an ArenaVec with a given capacity.
+ *
+ * @param vec Pointer to the ArenaVec structure to initialize.
+ * @param arena Pointer to the Arena to allocate from.
+ * @param elemSize The size of each element in bytes.
+ * @param cap The number of elements to reserve space for. May be zero.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the initial allocation fails or cap * elemSize
+ * overflows.
+ */
+int arena_vec_init(ArenaVec* vec, Arena* arena, size_t elemSize, size_t cap) {
+    vec->arena    = arena;
+    vec->data     = NULL;
+    vec->len      = 0;
+    vec->cap      = 0;
+    vec->elemSize = elemSize;
+
+    if (cap == 0) {
+        return ARENA_SUCCESS;
+    }
+
+    if (cap > arena_vec_max_cap(vec) || !(vec->data = arena_malloc(arena, cap * elemSize))) {
+        return ARENA_FAILURE;
+    }
+    vec->cap = cap;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Ensures the ArenaVec can hold at least cap elements.
+ *
+ * The allocation is grown in place when possible, and moved otherwise.
+ *
+ * @param vec Pointer to the ArenaVec structure.
+ * @param cap The number of elements to reserve space for.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is out of space or the size in
+ * bytes overflows.
+ */
+int arena_vec_reserve(ArenaVec* vec, size_t cap) {
+    if (cap <= vec->cap) {
+        return ARENA_SUCCESS;
+    }
+    if (cap > arena_vec_max_cap(vec)) {
+        return ARENA_FAILURE;
+    }
+
+    void* data = arena_resize(vec->arena, vec->data, vec->cap * vec->elemSize, cap * vec->elemSize);
+    if (!data) {
+        return ARENA_FAILURE;
+    }
+
+    vec->data = data;
+    vec->cap  = cap;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Appends n elements to the end of the ArenaVec.
+ *
+ * @param vec Pointer to the ArenaVec structure.
+ * @param elems Pointer to the elements to copy.
+ * @param n Number of elements to copy.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is out of space or the length
+ * overflows.
+ */
+int arena_vec_append(ArenaVec* vec, const void* elems, size_t n) {
+    if (vec->len + n < vec->len) {
+        return ARENA_FAILURE;
+    }
+
+    if (vec->len + n > vec->cap) {
+        size_t max = arena_vec_max_cap(vec);
+        size_t cap = vec->cap > max / 2 ? max : vec->cap * 2;
+        if (cap < ARENA_VEC_MIN_CAP) {
+            cap = ARENA_VEC_MIN_CAP;
+        }
+        if (cap < vec->len + n) {
+            cap = vec->len + n;
+        }
+
+        // Fall back to an exact fit if doubling does not fit in the arena
+        if (arena_vec_reserve(vec, cap) != ARENA_SUCCESS
+            && arena_vec_reserve(vec, vec->len + n) != ARENA_SUCCESS) {
+            return ARENA_FAILURE;
+        }
+    }
+
+    memcpy((char*) vec->data + vec->len * vec->elemSize, elems, n * vec->elemSize);
+    vec->len += n;
+    return ARENA_SUCCESS;
+}
+
+/**
+ * @brief Appends a single element to the end of the ArenaVec.
+ *
+ * @param vec Pointer to the ArenaVec structure.
+ * @param elem Pointer to the element to copy.
+ * @return ARENA_SUCCESS on success, ARENA_FAILURE if the arena is out of space.
+ */
+int arena_vec_push(ArenaVec* vec, const void* elem) { return arena_vec_append(vec, elem, 1); }
+
+/**
+ * @brief Shrinks the ArenaVec's allocation to fit its elements and returns it.
+ *
+ * The ArenaVec may still be appended to afterwards.
+ *
+ * @param vec Pointer to the ArenaVec structure.
+ * @return Pointer to the first element, or NULL if the ArenaVec has no allocation.
+ */
+void* arena_vec_finish(ArenaVec* vec) {
+    if (vec->data && vec->len > 0 && vec->len < vec->cap) {
+        void* data = arena_resize(vec->arena,
+                                  vec->data,
+                                  vec->cap * vec->elemSize,
+                                  vec->len * vec->elemSize);
+        if (data) {
+            vec->data = data;
+            vec->cap  = vec->len;
+        }
+    }
+
+    return vec->data;
+}
+
+/**
+ * @brief Returns the largest capacity whose size in bytes fits in a size_t.
+ *
+ * @param vec Pointer to the ArenaVec structure.
+ * @return Maximum number of elements.
+ */
+static size_t arena_vec_max_cap(const ArenaVec* vec) {
+    return vec->elemSize ? SIZE_MAX / vec->elemSize : SIZE_MAX;
+}
@@ -0,0 +1,52 @@
+#ifndef ARENA_VEC_H
+#define ARENA_VEC_H
+
+#include "arena.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize an ArenaVec holding elements of the given type
+ */
+#define ARENA_VEC_INIT(vec, arena, type, cap) arena_vec_init(vec, arena, sizeof(type), cap)
+
+/**
+ * @brief Push a value of the given type onto an ArenaVec
+ */
+#define ARENA_VEC_PUSH(vec, type, value) arena_vec_push(vec, &(type) { value })
+
+/**
+ * @brief Get the i-th element of an ArenaVec as the given type
+ */
+#define ARENA_VEC_AT(vec, type, i) (((type*) (vec)->data)[i])
+
+/**
+ * @struct ArenaVec
+ * @brief Growable array structure
+ *
+ * This structure represents a dynamic array stored inside an arena.
+ * When the array is the most recent allocation, or is followed by a free block, it grows in place.
+ */
+typedef struct {
+    Arena* arena; //!< The arena the array is allocated in.
+    void*  data; //!< A pointer to the first element of the array.
+    size_t len; //!< The number of elements in the array.
+    size_t cap; //!< The number of elements that fit in the current allocation.
+    size_t elemSize; //!< The size of each element in bytes.
+} ArenaVec;
+
+int   arena_vec_init(ArenaVec* vec, Arena* arena, size_t elemSize, size_t cap);
+int   arena_vec_reserve(ArenaVec* vec, size_t cap);
+int   arena_vec_push(ArenaVec* vec, const void* elem);
+int   arena_vec_append(ArenaVec* vec, const void* elems, size_t n);
+void* arena_vec_finish(ArenaVec* vec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,12 @@
 #include "arena/arena.h"
 #include "unity.h"
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #define INIT_MANAGED(s, b) arena = arena_init(s, b, 1)
 #define INIT_UNMANAGED(s)  arena = arena_init(s, 0, 0)
@@ -37,6 +39,15 @@ void test_arena_init_and_destroy_managed(void) {
     TEST_ASSERT_EQUAL(ARENA_SUCCESS, result);
 }
 
+void test_arena_init_managed_nonzero(void) {
+    // Any non-zero value still means managed, not a flags word
+    arena = arena_init(4096, 8, 2);
+    TEST_ASSERT_NOT_NULL(arena);
+    TEST_ASSERT_TRUE(arena->managed);
+    TEST_ASSERT_FALSE(arena->flags & ARENA_FLAG_COW);
+    TEST_ASSERT_NOT_NULL(arena->head);
+}
+
 void test_arena_init_and_destroy_unmanaged(void) {
     size_t arena_size = 2048;
 
@@ -280,3 +291,584 @@ void test_arena_collect_tag(void) {
     TEST_ASSERT_EQUAL(ARENA_STATUS_USED, block2->status);
     TEST_ASSERT_NOT_EQUAL(ARENA_STATUS_USED, block3->status);
 }
+
+void test_arena_realloc_managed_grows_in_place(void) {
+    INIT_MANAGED(1024, 10);
+    void* ptr = arena_malloc(arena, 128);
+    memset(ptr, 0xEE, 128);
+    void* new_ptr = arena_realloc(arena, ptr, 512);
+    TEST_ASSERT_EQUAL_PTR(ptr, new_ptr);
+    ArenaBlock* block = arena_get_block(arena, new_ptr);
+    TEST_ASSERT_EQUAL(512, block->size);
+    TEST_ASSERT_EQUAL(512, block->next->idx);
+    TEST_ASSERT_EQUAL(512, block->next->size);
+    for (size_t i = 0; i < 128; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0xEE, ((uint8_t*) new_ptr)[i]);
+    }
+}
+
+void test_arena_realloc_managed_moves(void) {
+    INIT_MANAGED(1024, 10);
+    void* ptr  = arena_malloc(arena, 128);
+    void* ptr2 = arena_malloc(arena, 128);
+    memset(ptr, 0xEE, 128);
+    void* new_ptr = arena_realloc(arena, ptr, 256);
+    TEST_ASSERT_NOT_NULL(new_ptr);
+    TEST_ASSERT_NOT_EQUAL(ptr, new_ptr);
+    for (size_t i = 0; i < 128; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0xEE, ((uint8_t*) new_ptr)[i]);
+    }
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, arena->head[0].status);
+}
+
+void test_arena_resize_unmanaged_top(void) {
+    INIT_UNMANAGED(1024);
+    void* ptr = arena_malloc(arena, 128);
+    TEST_ASSERT_EQUAL_PTR(ptr, arena_resize(arena, ptr, 128, 512));
+    TEST_ASSERT_EQUAL_PTR((char*) ptr + 512, arena->ptr);
+    TEST_ASSERT_EQUAL_PTR(ptr, arena_resize(arena, ptr, 512, 64));
+    TEST_ASSERT_EQUAL_PTR((char*) ptr + 64, arena->ptr);
+    TEST_ASSERT_NULL(arena_resize(arena, ptr, 64, 2048));
+}
+
+void test_arena_resize_unmanaged_not_top(void) {
+    INIT_UNMANAGED(1024);
+    void* ptr = arena_malloc(arena, 128);
+    arena_malloc(arena, 128);
+    memset(ptr, 0xAB, 128);
+    void* new_ptr = arena_resize(arena, ptr, 128, 256);
+    TEST_ASSERT_EQUAL_PTR((char*) ptr + 256, new_ptr);
+    for (size_t i = 0; i < 128; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0xAB, ((uint8_t*) new_ptr)[i]);
+    }
+}
+
+void test_arena_free_merges_neighbours(void) {
+    INIT_MANAGED(1024, 10);
+    void* ptr  = arena_malloc(arena, 128);
+    void* ptr2 = arena_malloc(arena, 128);
+    void* ptr3 = arena_malloc(arena, 128);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(arena, ptr));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(arena, ptr3));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(arena, ptr2));
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, arena->head->status);
+    TEST_ASSERT_EQUAL(0, arena->head->idx);
+    TEST_ASSERT_EQUAL(1024, arena->head->size);
+    TEST_ASSERT_NULL(arena->head->next);
+}
+
+void test_arena_reset_managed(void) {
+    INIT_MANAGED(1024, 10);
+    arena_malloc(arena, 128);
+    arena_malloc(arena, 256);
+    arena_malloc(arena, 64);
+    TEST_ASSERT_EQUAL(4, arena->blockCount);
+
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_reset(arena));
+    TEST_ASSERT_EQUAL(1, arena->blockCount);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, arena->head->status);
+    TEST_ASSERT_EQUAL(1024, arena->head->size);
+    TEST_ASSERT_NULL(arena->head->next);
+    TEST_ASSERT_NULL(arena_get_block_by_tag(arena, ARENA_TAG_NONE, 0));
+
+    void* ptr = arena_malloc(arena, 1024);
+    TEST_ASSERT_EQUAL_PTR(arena->mem, ptr);
+}
+
+void test_arena_reset_reuses_descriptors(void) {
+    INIT_MANAGED(1024, 3);
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_NOT_NULL(arena_malloc(arena, 100));
+        TEST_ASSERT_NOT_NULL(arena_malloc(arena, 100));
+        TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_reset(arena));
+    }
+    TEST_ASSERT_EQUAL(1, arena->blockCount);
+}
+
+void test_arena_reset_unmanaged(void) {
+    INIT_UNMANAGED(1024);
+    arena_malloc(arena, 1000);
+    TEST_ASSERT_NULL(arena_malloc(arena, 100));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_reset(arena));
+    TEST_ASSERT_EQUAL_PTR(arena->mem, arena_malloc(arena, 1024));
+}
+
+void test_arena_reset_mode(void) {
+    INIT_MANAGED(1 << 20, 10);
+    memset(arena_malloc(arena, 1 << 20), 0xAA, 1 << 20);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_reset_mode(arena, ARENA_RESET_RELEASE, 4096));
+    TEST_ASSERT_EQUAL(1 << 20, arena->head->size);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_reset_mode(arena, ARENA_RESET_WARM, 1 << 30));
+    void* ptr = arena_malloc(arena, 1 << 20);
+    TEST_ASSERT_NOT_NULL(ptr);
+    memset(ptr, 0xBB, 1 << 20);
+}
+
+#define REMOTE_THREADS 4
+#define REMOTE_BLOCKS  64
+
+static void* remote_free_worker(void* arg) {
+    void** ptrs = (void**) arg;
+    for (int i = 0; i < REMOTE_BLOCKS; i++) {
+        arena_free_remote(arena, ptrs[i]);
+    }
+    return NULL;
+}
+
+void test_arena_free_remote(void) {
+    static void* ptrs[REMOTE_THREADS][REMOTE_BLOCKS];
+    pthread_t    threads[REMOTE_THREADS];
+
+    INIT_MANAGED(REMOTE_THREADS * REMOTE_BLOCKS * 32, REMOTE_THREADS * REMOTE_BLOCKS + 1);
+    for (int t = 0; t < REMOTE_THREADS; t++) {
+        for (int i = 0; i < REMOTE_BLOCKS; i++) {
+            ptrs[t][i] = arena_malloc(arena, 32);
+            TEST_ASSERT_NOT_NULL(ptrs[t][i]);
+        }
+    }
+    TEST_ASSERT_NULL(arena_malloc(arena, 1));
+
+    for (int t = 0; t < REMOTE_THREADS; t++) {
+        pthread_create(&threads[t], NULL, remote_free_worker, ptrs[t]);
+    }
+    for (int t = 0; t < REMOTE_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // Nothing is freed until the owner allocates
+    TEST_ASSERT_NOT_NULL(arena->remoteFree);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_USED, arena->head->status);
+
+    void* ptr = arena_malloc(arena, REMOTE_THREADS * REMOTE_BLOCKS * 32);
+    TEST_ASSERT_EQUAL_PTR(arena->mem, ptr);
+    TEST_ASSERT_NULL(arena->remoteFree);
+}
+
+void test_arena_free_remote_unmanaged(void) {
+    INIT_UNMANAGED(1024);
+    void* ptr = arena_malloc(arena, 64);
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_free_remote(arena, ptr));
+}
+
+void test_arena_collect_remote(void) {
+    INIT_MANAGED(1024, 10);
+    void* ptr  = arena_malloc(arena, 64);
+    void* ptr2 = arena_malloc(arena, 64);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free_remote(arena, ptr2));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free_remote(arena, ptr));
+    arena_collect_remote(arena);
+    TEST_ASSERT_NULL(arena->remoteFree);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, arena->head->status);
+    TEST_ASSERT_EQUAL(1024, arena->head->size);
+}
+
+void test_arena_collect_remote_many(void) {
+    INIT_MANAGED(1000 * 16, 1001);
+    void* ptrs[1000];
+    for (int i = 0; i < 1000; i++) {
+        ptrs[i] = arena_malloc(arena, 16);
+    }
+
+    // Queue every other block in a scrambled order, then the rest
+    for (int i = 0; i < 1000; i += 2) {
+        arena_free_remote(arena, ptrs[(i * 7) % 1000]);
+    }
+    arena_collect_remote(arena);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_USED, arena_get_block(arena, ptrs[1])->status);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, arena->head->status);
+    TEST_ASSERT_EQUAL(16, arena->head->size);
+
+    for (int i = 999; i > 0; i -= 2) {
+        arena_free_remote(arena, ptrs[i]);
+    }
+    arena_collect_remote(arena);
+    TEST_ASSERT_EQUAL(1000 * 16, arena->head->size);
+    TEST_ASSERT_NULL(arena->head->next);
+}
+
+void test_arena_trim_managed(void) {
+    size_t size = 1 << 20;
+    INIT_MANAGED(size, 10);
+    void* ptr  = arena_malloc(arena, size / 2);
+    void* ptr2 = arena_malloc(arena, size / 2);
+    memset(ptr, 0xAA, size / 2);
+    memset(ptr2, 0xAA, size / 2);
+    TEST_ASSERT_EQUAL(0, arena_trim(arena));
+
+    arena_free(arena, ptr);
+    size_t released = arena_trim(arena);
+    TEST_ASSERT_GREATER_OR_EQUAL(size / 2 - 8192, released);
+    TEST_ASSERT_EQUAL(0, arena_trim(arena));
+
+    uint8_t* zeroed = (uint8_t*) arena_calloc(arena, size / 2, 1);
+    TEST_ASSERT_EQUAL_PTR(ptr, zeroed);
+    for (size_t i = 0; i < size / 2; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x00, zeroed[i]);
+    }
+    TEST_ASSERT_EQUAL_HEX8(0xAA, ((uint8_t*) ptr2)[0]);
+}
+
+void test_arena_trim_threshold(void) {
+    size_t size = 1 << 20;
+    INIT_MANAGED(size, 10);
+    arena->trimThreshold = size / 4;
+    void* small          = arena_malloc(arena, size / 8);
+    void* big            = arena_malloc(arena, size / 2);
+    memset(small, 0xAA, size / 8);
+    memset(big, 0xAA, size / 2);
+
+    arena_free(arena, small);
+    TEST_ASSERT_NULL(arena->zeroPages);
+    arena_free(arena, big);
+    TEST_ASSERT_NOT_NULL(arena->zeroPages);
+    TEST_ASSERT_EQUAL(0, arena_trim(arena));
+
+    uint8_t* zeroed = (uint8_t*) arena_calloc(arena, size, 1);
+    TEST_ASSERT_NOT_NULL(zeroed);
+    for (size_t i = 0; i < size; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x00, zeroed[i]);
+    }
+}
+
+void test_arena_trim_unmanaged(void) {
+    size_t size = 1 << 20;
+    INIT_UNMANAGED(size);
+    memset(arena->mem, 0xAA, size);
+    arena_malloc(arena, size / 2);
+    TEST_ASSERT_GREATER_OR_EQUAL(size / 2 - 8192, arena_trim(arena));
+
+    uint8_t* zeroed = (uint8_t*) arena_calloc(arena, size / 2, 1);
+    TEST_ASSERT_NOT_NULL(zeroed);
+    for (size_t i = 0; i < size / 2; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x00, zeroed[i]);
+    }
+    TEST_ASSERT_EQUAL(0, arena_trim(arena));
+}
+
+void test_arena_calloc_overflow(void) {
+    INIT_UNMANAGED(1024);
+    TEST_ASSERT_NULL(arena_calloc(arena, SIZE_MAX / 2, 4));
+}
+
+void test_arena_clone_cow_managed(void) {
+    size_t size = 1 << 16;
+    arena       = arena_init_flags(size, 10, ARENA_FLAG_MANAGED | ARENA_FLAG_COW);
+    TEST_ASSERT_NOT_NULL(arena);
+    uint8_t* ptr  = (uint8_t*) arena_malloc(arena, 4096);
+    uint8_t* ptr2 = (uint8_t*) arena_malloc(arena, 4096);
+    memset(ptr, 0xAA, 4096);
+    memset(ptr2, 0xBB, 4096);
+
+    Arena* clone = arena_clone(arena);
+    TEST_ASSERT_NOT_NULL(clone);
+    TEST_ASSERT_NOT_EQUAL(arena->mem, clone->mem);
+    TEST_ASSERT_EQUAL(arena->blockCount, clone->blockCount);
+
+    uint8_t* clonePtr = (uint8_t*) clone->mem + ((uint8_t*) ptr - (uint8_t*) arena->mem);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, clonePtr[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xBB, clonePtr[4096]);
+
+    // Writes on either side are private
+    memset(clonePtr, 0xCC, 4096);
+    memset(ptr2, 0xDD, 4096);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, ptr[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xBB, clonePtr[4096]);
+
+    // Metadata is independent and points into the clone
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(clone, clonePtr));
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, clone->head->status);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_USED, arena->head->status);
+    TEST_ASSERT_EQUAL_PTR(clone->head, clone->head->next->prev);
+
+    // Cloning again while the first clone is alive moves to a new snapshot
+    Arena* clone2 = arena_clone(arena);
+    TEST_ASSERT_NOT_NULL(clone2);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, ((uint8_t*) clone2->mem)[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xDD, ((uint8_t*) clone2->mem)[4096]);
+    TEST_ASSERT_EQUAL_HEX8(0xCC, clonePtr[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xBB, clonePtr[4096]);
+
+    arena_destroy(clone);
+    arena_destroy(clone2);
+
+    // Cloning with no other views writes the modified pages back
+    memset(ptr, 0xEE, 4096);
+    Arena* clone3 = arena_clone(arena);
+    TEST_ASSERT_NOT_NULL(clone3);
+    TEST_ASSERT_EQUAL_HEX8(0xEE, ((uint8_t*) clone3->mem)[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xDD, ((uint8_t*) clone3->mem)[4096]);
+    TEST_ASSERT_EQUAL_HEX8(0xEE, ptr[0]);
+    arena_destroy(clone3);
+}
+
+void test_arena_clone_unmanaged(void) {
+    arena     = arena_init_flags(1024, 0, ARENA_FLAG_COW);
+    char* str = (char*) arena_malloc(arena, 16);
+    strcpy(str, "hello");
+
+    Arena* clone = arena_clone(arena);
+    TEST_ASSERT_NOT_NULL(clone);
+    TEST_ASSERT_EQUAL((char*) arena->ptr - (char*) arena->mem, (char*) clone->ptr - (char*) clone->mem);
+    TEST_ASSERT_EQUAL_STRING("hello", (char*) clone->mem);
+    arena_destroy(clone);
+}
+
+void test_arena_clone_copy(void) {
+    INIT_MANAGED(1024, 10);
+    char* str = (char*) arena_malloc(arena, 16);
+    strcpy(str, "hello");
+
+    Arena* clone = arena_clone(arena);
+    TEST_ASSERT_NOT_NULL(clone);
+    TEST_ASSERT_NULL(clone->backing);
+    TEST_ASSERT_EQUAL_STRING("hello", (char*) clone->mem);
+    TEST_ASSERT_NOT_NULL(arena_get_block(clone, clone->mem));
+    TEST_ASSERT_EQUAL(16, arena_get_block(clone, clone->mem)->size);
+    strcpy((char*) clone->mem, "world");
+    TEST_ASSERT_EQUAL_STRING("hello", str);
+    arena_destroy(clone);
+}
+
+ARENA_STATIC_MANAGED(staticManaged, 1024, 8);
+ARENA_STATIC_UNMANAGED(staticUnmanaged, 1024);
+
+void test_arena_init_in_managed(void) {
+    static ArenaBlock descriptors[10];
+    unsigned char     buffer[2048];
+
+    Arena* inner = arena_init_in(buffer, sizeof(buffer), descriptors, 10, ARENA_FLAG_MANAGED);
+    TEST_ASSERT_NOT_NULL(inner);
+    TEST_ASSERT_TRUE((unsigned char*) inner >= buffer);
+    TEST_ASSERT_TRUE((unsigned char*) inner->mem + inner->size == buffer + sizeof(buffer));
+    TEST_ASSERT_EQUAL_PTR(descriptors, inner->head);
+    TEST_ASSERT_EQUAL(0, (size_t) inner->mem % ARENA_ALIGNMENT);
+
+    void* ptr = arena_malloc(inner, 128);
+    TEST_ASSERT_EQUAL_PTR(inner->mem, ptr);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(inner, ptr));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_destroy(inner));
+}
+
+void test_arena_init_in_nested(void) {
+    INIT_MANAGED(4096, 10);
+    void*  buffer = arena_malloc(arena, 2048);
+    Arena* inner  = arena_init_in(buffer, 2048, NULL, 16, ARENA_FLAG_MANAGED);
+    TEST_ASSERT_NOT_NULL(inner);
+    TEST_ASSERT_TRUE((char*) inner->head > (char*) inner);
+    TEST_ASSERT_TRUE((char*) inner->mem >= (char*) (inner->head + 16));
+
+    void* ptr = arena_calloc(inner, inner->size, 1);
+    TEST_ASSERT_NOT_NULL(ptr);
+    TEST_ASSERT_NULL(arena_malloc(inner, 1));
+    arena_destroy(inner);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(arena, buffer));
+}
+
+void test_arena_init_in_too_small(void) {
+    unsigned char buffer[64];
+    TEST_ASSERT_NULL(arena_init_in(buffer, sizeof(Arena), NULL, 0, 0));
+    TEST_ASSERT_NULL(arena_init_in(buffer, sizeof(buffer), NULL, 16, ARENA_FLAG_MANAGED));
+    TEST_ASSERT_NULL(arena_init_in(buffer, sizeof(buffer), NULL, 0, ARENA_FLAG_COW));
+}
+
+void test_arena_static_managed(void) {
+    TEST_ASSERT_EQUAL(1024, staticManaged->size);
+    void* ptr  = arena_malloc(staticManaged, 512);
+    void* ptr2 = arena_malloc(staticManaged, 512);
+    TEST_ASSERT_EQUAL_PTR(staticManaged->mem, ptr);
+    TEST_ASSERT_NOT_NULL(ptr2);
+    TEST_ASSERT_NULL(arena_malloc(staticManaged, 1));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(staticManaged, ptr));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_reset(staticManaged));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_destroy(staticManaged));
+    TEST_ASSERT_NOT_NULL(arena_malloc(staticManaged, 1024));
+    arena_reset(staticManaged);
+}
+
+void test_arena_static_unmanaged(void) {
+    TEST_ASSERT_EQUAL_PTR(staticUnmanaged->mem, arena_malloc(staticUnmanaged, 1000));
+    TEST_ASSERT_NULL(arena_malloc(staticUnmanaged, 100));
+    TEST_ASSERT_EQUAL(0, arena_trim(staticUnmanaged));
+    arena_reset(staticUnmanaged);
+}
+
+void test_arena_memalign_managed(void) {
+    INIT_MANAGED(4096, 10);
+    void* ptr = arena_malloc(arena, 3);
+    void* aligned = arena_memalign(arena, 256, 100);
+    TEST_ASSERT_NOT_NULL(aligned);
+    TEST_ASSERT_EQUAL(0, (size_t) aligned % 256);
+
+    // The padding stays free and is reused
+    ArenaBlock* pad = arena_get_block(arena, aligned)->prev;
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, pad->status);
+    TEST_ASSERT_EQUAL(3, pad->idx);
+    TEST_ASSERT_EQUAL_PTR((char*) ptr + 3, arena_malloc(arena, 8));
+
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free(arena, aligned));
+    TEST_ASSERT_NULL(arena_memalign(arena, 24, 8));
+}
+
+void test_arena_memalign_unmanaged(void) {
+    INIT_UNMANAGED(1024);
+    arena_malloc(arena, 1);
+    void* aligned = arena_memalign(arena, 64, 64);
+    TEST_ASSERT_NOT_NULL(aligned);
+    TEST_ASSERT_EQUAL(0, (size_t) aligned % 64);
+    TEST_ASSERT_EQUAL_PTR((char*) aligned + 64, arena->ptr);
+    TEST_ASSERT_NULL(arena_memalign(arena, 64, 1024));
+}
+
+typedef struct {
+    ArenaRef next;
+    int      value;
+} RefNode;
+
+void test_arena_ref(void) {
+    INIT_MANAGED(1024, 10);
+    int   local;
+    void* ptr = arena_malloc(arena, 32);
+    ptr       = arena_malloc(arena, 32);
+
+    ArenaRef ref = arena_ref(arena, ptr);
+    TEST_ASSERT_EQUAL(33, ref);
+    TEST_ASSERT_EQUAL(ref, ARENA_REF(arena, ptr));
+    TEST_ASSERT_EQUAL_PTR(ptr, arena_deref(arena, ref));
+    TEST_ASSERT_EQUAL_PTR(ptr, ARENA_DEREF(arena, char, ref));
+
+    TEST_ASSERT_EQUAL(ARENA_REF_NULL, arena_ref(arena, NULL));
+    TEST_ASSERT_EQUAL(ARENA_REF_NULL, arena_ref(arena, &local));
+    TEST_ASSERT_NULL(arena_deref(arena, ARENA_REF_NULL));
+    TEST_ASSERT_NULL(arena_deref(arena, 1026));
+}
+
+void test_arena_alloc_ref(void) {
+    INIT_MANAGED(1024, 10);
+    ArenaRef ref = arena_malloc_ref(arena, 16);
+    TEST_ASSERT_EQUAL(1, ref);
+    memset(arena_deref(arena, ref), 0xAB, 16);
+
+    ArenaRef zeroed = arena_calloc_ref(arena, 4, 8);
+    TEST_ASSERT_EQUAL(17, zeroed);
+    for (int i = 0; i < 32; i++) {
+        TEST_ASSERT_EQUAL(0, ARENA_DEREF(arena, unsigned char, zeroed)[i]);
+    }
+
+    // Growing past the zeroed block moves the data
+    ArenaRef moved = arena_realloc_ref(arena, ref, 64);
+    TEST_ASSERT_EQUAL(49, moved);
+    TEST_ASSERT_EQUAL(0xAB, ARENA_DEREF(arena, unsigned char, moved)[15]);
+
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free_ref(arena, zeroed));
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_free_ref(arena, ARENA_REF_NULL));
+    TEST_ASSERT_EQUAL(ARENA_REF_NULL, arena_malloc_ref(arena, 2048));
+    TEST_ASSERT_NOT_EQUAL(ARENA_REF_NULL, arena_realloc_ref(arena, ARENA_REF_NULL, 8));
+}
+
+void test_arena_open(void) {
+    char path[] = "/tmp/test_arena_XXXXXX";
+    int  fd     = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+
+    // Build a list whose links are references, then dump it
+    INIT_UNMANAGED(256);
+    ArenaRef head = ARENA_REF_NULL;
+    for (int i = 0; i < 5; i++) {
+        ArenaRef ref                            = arena_malloc_ref(arena, sizeof(RefNode));
+        ARENA_DEREF(arena, RefNode, ref)->next  = head;
+        ARENA_DEREF(arena, RefNode, ref)->value = i;
+        head                                    = ref;
+    }
+    FILE* f = fdopen(fd, "wb");
+    arena_dump(arena, f);
+    fclose(f);
+    arena_destroy(arena);
+
+    arena = arena_open(path);
+    unlink(path);
+    TEST_ASSERT_NOT_NULL(arena);
+    TEST_ASSERT_EQUAL(256, arena->size);
+    TEST_ASSERT_FALSE(arena->managed);
+    TEST_ASSERT_NULL(arena_malloc(arena, 1));
+
+    int expected = 4;
+    for (ArenaRef ref = head; ref != ARENA_REF_NULL;) {
+        RefNode* node = ARENA_DEREF(arena, RefNode, ref);
+        TEST_ASSERT_EQUAL(expected--, node->value);
+        node->value = -1;
+        ref         = node->next;
+    }
+    TEST_ASSERT_EQUAL(-1, expected);
+    TEST_ASSERT_EQUAL(0, arena_reset_mode(arena, ARENA_RESET_RELEASE, 0));
+
+    TEST_ASSERT_NULL(arena_open(path));
+}
+
+void test_arena_free_batch(void) {
+    INIT_MANAGED(1024, 10);
+    void* ptrs[6];
+    int   status[8];
+    for (int i = 0; i < 6; i++) {
+        ptrs[i] = arena_malloc(arena, 100);
+    }
+
+    // Out of order, with a repeat, a NULL, and a pointer into the middle of a block
+    void* batch[8] = { ptrs[4], ptrs[1], ptrs[2], NULL, ptrs[4], ptrs[0], (char*) ptrs[3] + 1,
+                       ptrs[5] };
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_free_batch(arena, batch, 8, status));
+
+    // The batch is sorted by address with NULL last, and the statuses follow it
+    void* sorted[8]   = { ptrs[0], ptrs[1], ptrs[2], (char*) ptrs[3] + 1,
+                          ptrs[4], ptrs[4], ptrs[5], NULL };
+    int   expected[8] = { ARENA_SUCCESS, ARENA_SUCCESS, ARENA_SUCCESS, ARENA_FAILURE,
+                          ARENA_SUCCESS, ARENA_FAILURE, ARENA_SUCCESS, ARENA_FAILURE };
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL_PTR(sorted[i], batch[i]);
+        TEST_ASSERT_EQUAL(expected[i], status[i]);
+    }
+
+    // Everything but ptrs[3] is coalesced around it
+    ArenaBlock* block = arena_get_block(arena, ptrs[3]);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_USED, block->status);
+    TEST_ASSERT_EQUAL_PTR(arena->head, block->prev);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, block->prev->status);
+    TEST_ASSERT_EQUAL(300, block->prev->size);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, block->next->status);
+    TEST_ASSERT_EQUAL(624, block->next->size);
+    TEST_ASSERT_NULL(block->next->next);
+
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free_batch(arena, &ptrs[3], 1, NULL));
+    TEST_ASSERT_EQUAL(1024, arena->head->size);
+    TEST_ASSERT_NULL(arena->head->next);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free_batch(arena, NULL, 0, NULL));
+}
+
+void test_arena_free_batch_unmanaged(void) {
+    INIT_UNMANAGED(1024);
+    void* ptr    = arena_malloc(arena, 16);
+    int   status = ARENA_SUCCESS;
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_free_batch(arena, &ptr, 1, &status));
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, status);
+}
+
+void test_arena_free_batch_large(void) {
+    INIT_MANAGED(1000 * 16, 1001);
+    void* ptrs[1000];
+    int   status[1000];
+    for (int i = 0; i < 1000; i++) {
+        ptrs[i] = arena_malloc(arena, 16);
+    }
+
+    // In descending order
+    for (int i = 0; i < 500; i++) {
+        void* tmp     = ptrs[i];
+        ptrs[i]       = ptrs[999 - i];
+        ptrs[999 - i] = tmp;
+    }
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_free_batch(arena, ptrs, 1000, status));
+    for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT_EQUAL(ARENA_SUCCESS, status[i]);
+    }
+    TEST_ASSERT_EQUAL(1000 * 16, arena->head->size);
+    TEST_ASSERT_NULL(arena->head->next);
+}
@@ -0,0 +1,126 @@
+#include "arena/arena.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INIT_MANAGED(s, b) arena = arena_init(s, b, 1)
+
+#define BUFFER_SIZE 4096
+#define SIGN(x)     (((x) > 0) - ((x) < 0))
+
+static const char* isas[] = { "scalar", "sse2", "avx2", "avx512f" };
+
+Arena*        arena;
+unsigned char src[BUFFER_SIZE];
+unsigned char dst[BUFFER_SIZE];
+unsigned char expected[BUFFER_SIZE];
+
+void          setUp(void) {
+    for (size_t i = 0; i < BUFFER_SIZE; i++) {
+        src[i] = (unsigned char) (i * 31 + 7);
+    }
+    arena_set_stream_threshold(1);
+}
+
+void tearDown(void) {
+    arena_set_stream_threshold(ARENA_STREAM_THRESHOLD);
+    arena_set_kernel_isa(NULL);
+    if (arena) {
+        arena_destroy(arena);
+        arena = NULL;
+    }
+}
+
+void test_arena_kernel_isa(void) {
+    TEST_ASSERT_NOT_NULL(arena_kernel_isa());
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_set_kernel_isa("scalar"));
+    TEST_ASSERT_EQUAL_STRING("scalar", arena_kernel_isa());
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_set_kernel_isa("mmx"));
+    TEST_ASSERT_EQUAL_STRING("scalar", arena_kernel_isa());
+}
+
+void test_arena_kernel_threshold(void) {
+    TEST_ASSERT_EQUAL(1, arena_get_stream_threshold());
+    arena_set_stream_threshold(SIZE_MAX);
+    TEST_ASSERT_EQUAL(SIZE_MAX, arena_get_stream_threshold());
+}
+
+void test_arena_memcpy(void) {
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (arena_set_kernel_isa(isas[k]) != ARENA_SUCCESS) {
+            continue;
+        }
+
+        // Every head misalignment, and lengths around each unrolled loop
+        for (size_t offset = 0; offset < 64; offset += 7) {
+            for (size_t n = 0; n < 600; n += 13) {
+                memset(dst, 0xEE, BUFFER_SIZE);
+                memset(expected, 0xEE, BUFFER_SIZE);
+                memcpy(expected + offset, src + 3, n);
+                TEST_ASSERT_EQUAL_PTR(dst + offset, arena_memcpy(dst + offset, src + 3, n));
+                TEST_ASSERT_EQUAL_MEMORY(expected, dst, BUFFER_SIZE);
+            }
+        }
+    }
+}
+
+void test_arena_memset(void) {
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        if (arena_set_kernel_isa(isas[k]) != ARENA_SUCCESS) {
+            continue;
+        }
+
+        for (size_t offset = 0; offset < 64; offset += 5) {
+            for (size_t n = 0; n < 600; n += 11) {
+                memset(dst, 0xEE, BUFFER_SIZE);
+                memset(expected, 0xEE, BUFFER_SIZE);
+                memset(expected + offset, 0x9C, n);
+                TEST_ASSERT_EQUAL_PTR(dst + offset, arena_memset(dst + offset, 0x19C, n));
+                TEST_ASSERT_EQUAL_MEMORY(expected, dst, BUFFER_SIZE);
+
+                memset(expected + offset, 0, n);
+                arena_memzero(dst + offset, n);
+                TEST_ASSERT_EQUAL_MEMORY(expected, dst, BUFFER_SIZE);
+            }
+        }
+    }
+}
+
+void test_arena_memcmp(void) {
+    memcpy(dst, src, BUFFER_SIZE);
+    TEST_ASSERT_EQUAL(0, arena_memcmp(src, dst, BUFFER_SIZE));
+    for (size_t i = 0; i < 300; i += 7) {
+        dst[i] ^= 0x5A;
+        TEST_ASSERT_EQUAL(SIGN(memcmp(src, dst, 300)), SIGN(arena_memcmp(src, dst, 300)));
+        TEST_ASSERT_EQUAL(SIGN(memcmp(dst, src, 300)), SIGN(arena_memcmp(dst, src, 300)));
+        TEST_ASSERT_NOT_EQUAL(0, arena_memcmp(src, dst, 300));
+        TEST_ASSERT_EQUAL(0, arena_memcmp(src + i + 1, dst + i + 1, 200));
+        dst[i] ^= 0x5A;
+    }
+}
+
+void test_arena_calloc_streaming(void) {
+    INIT_MANAGED(8192, 10);
+    void* ptr = arena_malloc(arena, 8192);
+    memset(ptr, 0xFF, 8192);
+    arena_free(arena, ptr);
+
+    unsigned char* zeroed = (unsigned char*) arena_calloc(arena, 1, 8000);
+    TEST_ASSERT_NOT_NULL(zeroed);
+    for (size_t i = 0; i < 8000; i++) {
+        TEST_ASSERT_EQUAL(0, zeroed[i]);
+    }
+}
+
+void test_arena_realloc_streaming(void) {
+    INIT_MANAGED(8192, 10);
+    unsigned char* ptr = (unsigned char*) arena_malloc(arena, 1000);
+    memcpy(ptr, src, 1000);
+    arena_malloc(arena, 1);
+
+    unsigned char* moved = (unsigned char*) arena_realloc(arena, ptr, 3000);
+    TEST_ASSERT_NOT_EQUAL(ptr, moved);
+    TEST_ASSERT_EQUAL_MEMORY(src, moved, 1000);
+}
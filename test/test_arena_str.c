@@ -0,0 +1,99 @@
+#include "arena/arena.h"
+#include "arena/arena_str.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INIT_MANAGED(s, b) arena = arena_init(s, b, 1)
+#define INIT_UNMANAGED(s)  arena = arena_init(s, 0, 0)
+
+Arena* arena;
+
+void   setUp(void) {}
+
+void   tearDown(void) {
+    if (arena) {
+        arena_destroy(arena);
+        arena = NULL;
+    }
+}
+
+void test_arena_str_append_unmanaged(void) {
+    ArenaStr str;
+    INIT_UNMANAGED(1024);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_str_init(&str, arena, 0));
+    TEST_ASSERT_EQUAL_STRING("", str.data);
+    arena_str_append(&str, "hello", 5);
+    arena_str_push(&str, ',');
+    arena_str_append(&str, " world", 6);
+    TEST_ASSERT_EQUAL_STRING("hello, world", str.data);
+    TEST_ASSERT_EQUAL(12, str.len);
+}
+
+void test_arena_str_grows_in_place_unmanaged(void) {
+    ArenaStr str;
+    INIT_UNMANAGED(1024);
+    arena_str_init(&str, arena, 4);
+    char* data = str.data;
+    for (int i = 0; i < 100; i++) {
+        arena_str_push(&str, 'a' + i % 26);
+    }
+    TEST_ASSERT_EQUAL_PTR(data, str.data);
+    TEST_ASSERT_EQUAL(100, strlen(str.data));
+}
+
+void test_arena_str_format_managed(void) {
+    ArenaStr str;
+    INIT_MANAGED(1024, 10);
+    arena_str_init(&str, arena, 4);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_str_format(&str, "%d-%s", 42, "answer"));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_str_format(&str, "/%05.1f", 2.5));
+    TEST_ASSERT_EQUAL_STRING("42-answer/002.5", str.data);
+    TEST_ASSERT_EQUAL(15, str.len);
+}
+
+void test_arena_str_finish_managed(void) {
+    ArenaStr str;
+    INIT_MANAGED(1024, 10);
+    arena_str_init(&str, arena, 64);
+    arena_str_append(&str, "abc", 3);
+    char* s = arena_str_finish(&str);
+    TEST_ASSERT_EQUAL_STRING("abc", s);
+    TEST_ASSERT_EQUAL(4, arena_get_block(arena, s)->size);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, arena_get_block(arena, s)->next->status);
+}
+
+void test_arena_str_finish_unmanaged(void) {
+    ArenaStr str;
+    INIT_UNMANAGED(1024);
+    arena_str_init(&str, arena, 64);
+    arena_str_format(&str, "%s", "xyz");
+    char* s = arena_str_finish(&str);
+    TEST_ASSERT_EQUAL_STRING("xyz", s);
+    TEST_ASSERT_EQUAL_PTR(s + 4, arena->ptr);
+}
+
+void test_arena_str_out_of_space(void) {
+    ArenaStr str;
+    INIT_UNMANAGED(16);
+    arena_str_init(&str, arena, 0);
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_str_format(&str, "%s", "this is too long to fit"));
+    TEST_ASSERT_EQUAL_STRING("", str.data);
+    TEST_ASSERT_EQUAL(0, str.len);
+}
+
+void test_arena_str_overflow(void) {
+    ArenaStr str;
+    INIT_UNMANAGED(64);
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_str_init(&str, arena, SIZE_MAX));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_str_init(&str, arena, 4));
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_str_reserve(&str, SIZE_MAX));
+    TEST_ASSERT_EQUAL(4, str.cap);
+    arena_str_append(&str, "ab", 2);
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_str_append(&str, "c", SIZE_MAX - 1));
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_str_append(&str, "c", SIZE_MAX));
+    TEST_ASSERT_EQUAL_STRING("ab", str.data);
+    TEST_ASSERT_EQUAL(2, str.len);
+}
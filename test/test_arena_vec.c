@@ -0,0 +1,127 @@
+#include "arena/arena.h"
+#include "arena/arena_vec.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INIT_MANAGED(s, b) arena = arena_init(s, b, 1)
+#define INIT_UNMANAGED(s)  arena = arena_init(s, 0, 0)
+
+Arena* arena;
+
+void   setUp(void) {}
+
+void   tearDown(void) {
+    if (arena) {
+        arena_destroy(arena);
+        arena = NULL;
+    }
+}
+
+void test_arena_vec_push_unmanaged(void) {
+    ArenaVec vec;
+    INIT_UNMANAGED(4096);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, ARENA_VEC_INIT(&vec, arena, int, 0));
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_EQUAL(ARENA_SUCCESS, ARENA_VEC_PUSH(&vec, int, i));
+    }
+    TEST_ASSERT_EQUAL(100, vec.len);
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_EQUAL(i, ARENA_VEC_AT(&vec, int, i));
+    }
+}
+
+void test_arena_vec_grows_in_place_unmanaged(void) {
+    ArenaVec vec;
+    INIT_UNMANAGED(4096);
+    ARENA_VEC_INIT(&vec, arena, int, 4);
+    void* data = vec.data;
+    for (int i = 0; i < 64; i++) {
+        ARENA_VEC_PUSH(&vec, int, i);
+    }
+    TEST_ASSERT_EQUAL_PTR(data, vec.data);
+    TEST_ASSERT_EQUAL_PTR((char*) data + vec.cap * sizeof(int), arena->ptr);
+}
+
+void test_arena_vec_moves_when_not_top_unmanaged(void) {
+    ArenaVec vec;
+    INIT_UNMANAGED(4096);
+    ARENA_VEC_INIT(&vec, arena, int, 2);
+    ARENA_VEC_PUSH(&vec, int, 1);
+    ARENA_VEC_PUSH(&vec, int, 2);
+    void* data = vec.data;
+    arena_malloc(arena, 16);
+    ARENA_VEC_PUSH(&vec, int, 3);
+    TEST_ASSERT_NOT_EQUAL_PTR(data, vec.data);
+    TEST_ASSERT_EQUAL(1, ARENA_VEC_AT(&vec, int, 0));
+    TEST_ASSERT_EQUAL(2, ARENA_VEC_AT(&vec, int, 1));
+    TEST_ASSERT_EQUAL(3, ARENA_VEC_AT(&vec, int, 2));
+}
+
+void test_arena_vec_grows_in_place_managed(void) {
+    ArenaVec vec;
+    INIT_MANAGED(4096, 10);
+    ARENA_VEC_INIT(&vec, arena, int, 4);
+    void* data = vec.data;
+    for (int i = 0; i < 64; i++) {
+        ARENA_VEC_PUSH(&vec, int, i);
+    }
+    TEST_ASSERT_EQUAL_PTR(data, vec.data);
+    ArenaBlock* block = arena_get_block(arena, vec.data);
+    TEST_ASSERT_NOT_NULL(block);
+    TEST_ASSERT_EQUAL(vec.cap * sizeof(int), block->size);
+    TEST_ASSERT_EQUAL(ARENA_STATUS_FREE, block->next->status);
+}
+
+void test_arena_vec_append_and_finish_managed(void) {
+    ArenaVec vec;
+    int      elems[] = { 1, 2, 3, 4, 5 };
+    INIT_MANAGED(1024, 10);
+    ARENA_VEC_INIT(&vec, arena, int, 0);
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_vec_append(&vec, elems, 5));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, arena_vec_reserve(&vec, 32));
+    TEST_ASSERT_EQUAL(32, vec.cap);
+
+    int* data = (int*) arena_vec_finish(&vec);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_EQUAL(5, vec.cap);
+    TEST_ASSERT_EQUAL_MEMORY(elems, data, sizeof(elems));
+    TEST_ASSERT_EQUAL(sizeof(elems), arena_get_block(arena, data)->size);
+}
+
+void test_arena_vec_finish_unmanaged(void) {
+    ArenaVec vec;
+    INIT_UNMANAGED(1024);
+    ARENA_VEC_INIT(&vec, arena, uint64_t, 16);
+    ARENA_VEC_PUSH(&vec, uint64_t, 7);
+    arena_vec_finish(&vec);
+    TEST_ASSERT_EQUAL_PTR((char*) vec.data + sizeof(uint64_t), arena->ptr);
+}
+
+void test_arena_vec_out_of_space(void) {
+    ArenaVec vec;
+    INIT_UNMANAGED(64);
+    ARENA_VEC_INIT(&vec, arena, uint64_t, 0);
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL(ARENA_SUCCESS, ARENA_VEC_PUSH(&vec, uint64_t, i));
+    }
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, ARENA_VEC_PUSH(&vec, uint64_t, 8));
+    TEST_ASSERT_EQUAL(8, vec.len);
+}
+
+void test_arena_vec_overflow(void) {
+    ArenaVec vec;
+    int      elem = 0;
+    INIT_UNMANAGED(64);
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, ARENA_VEC_INIT(&vec, arena, int, SIZE_MAX / 4 + 3));
+    TEST_ASSERT_EQUAL(ARENA_SUCCESS, ARENA_VEC_INIT(&vec, arena, int, 2));
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_vec_reserve(&vec, SIZE_MAX / 4 + 3));
+    TEST_ASSERT_EQUAL(2, vec.cap);
+    ARENA_VEC_PUSH(&vec, int, 1);
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_vec_append(&vec, &elem, SIZE_MAX));
+    TEST_ASSERT_EQUAL(ARENA_FAILURE, arena_vec_append(&vec, &elem, SIZE_MAX / 4));
+    TEST_ASSERT_EQUAL(1, vec.len);
+    TEST_ASSERT_EQUAL(2, vec.cap);
+}